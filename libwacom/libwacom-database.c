@@ -29,6 +29,7 @@
 #define _GNU_SOURCE 1
 #include <assert.h>
 #include <dirent.h>
+#include <errno.h>
 #include <glib.h>
 #include <libevdev/libevdev.h>
 #include <stdbool.h>
@@ -43,6 +44,7 @@
 
 #define TABLET_SUFFIX ".tablet"
 #define STYLUS_SUFFIX ".stylus"
+#define UNIQ_SUFFIX ".uniq"
 #define FEATURES_GROUP "Features"
 #define DEVICE_GROUP "Device"
 #define BUTTONS_GROUP "Buttons"
@@ -257,7 +259,8 @@ out:
 }
 
 static WacomMatch *
-libwacom_match_from_string(const char *matchstr)
+libwacom_match_from_string(WacomDeviceDatabase *db,
+			   const char *matchstr)
 {
 	g_autofree char *name = NULL;
 	g_autofree char *uniq = NULL;
@@ -285,13 +288,14 @@ libwacom_match_from_string(const char *matchstr)
 		return NULL;
 	}
 
-	match = libwacom_match_new(name, uniq, bus, vendor_id, product_id);
+	match = libwacom_match_new(db->arena, name, uniq, bus, vendor_id, product_id);
 
 	return match;
 }
 
 static gboolean
-libwacom_matchstr_to_paired(WacomDevice *device,
+libwacom_matchstr_to_paired(WacomDeviceDatabase *db,
+			    WacomDevice *device,
 			    const char *matchstr)
 {
 	g_autofree char *name = NULL;
@@ -307,7 +311,8 @@ libwacom_matchstr_to_paired(WacomDevice *device,
 		return FALSE;
 	}
 
-	device->paired = libwacom_match_new(name, uniq, bus, vendor_id, product_id);
+	device->paired =
+		libwacom_match_new(db->arena, name, uniq, bus, vendor_id, product_id);
 
 	return TRUE;
 }
@@ -417,17 +422,16 @@ boolean_or_fallback(GKeyFile *keyfile,
 }
 
 static gchar **
-stylus_ids_as_hex(GArray *array)
+stylus_ids_as_hex(const WacomStylusId *ids,
+		  guint nids)
 {
-	WacomStylusId *id;
 	g_autoptr(GStrvBuilder) builder = g_strv_builder_new();
 
-	if (array == NULL || array->len == 0)
+	if (ids == NULL || nids == 0)
 		return NULL;
 
-	for (guint i = 0; i < array->len; i++) {
-		id = &g_array_index(array, WacomStylusId, i);
-		g_autofree char *hex = g_strdup_printf("0x%08x", id->tool_id);
+	for (guint i = 0; i < nids; i++) {
+		g_autofree char *hex = g_strdup_printf("0x%08x", ids[i].tool_id);
 		g_strv_builder_add(builder, hex);
 	}
 
@@ -460,8 +464,11 @@ libwacom_parse_stylus_keyfile(WacomDeviceDatabase *db,
 		WacomStylus *stylus = NULL, *aliased = NULL;
 		WacomStylusId id;
 		g_autoptr(GError) error = NULL;
+		g_autofree char *name = NULL;
+		g_autofree char *group = NULL;
 		g_autofree char *eraser_type = NULL;
 		g_autofree char *type = NULL;
+		g_autoptr(GArray) paired_stylus_ids = NULL;
 
 		if (!parse_stylus_id(groups[i], &id)) {
 			g_warning("Failed to parse stylus ID '%s', ignoring entry",
@@ -509,19 +516,21 @@ libwacom_parse_stylus_keyfile(WacomDeviceDatabase *db,
 			continue;
 		}
 
-		stylus = g_new0(WacomStylus, 1);
-		g_atomic_ref_count_init(&stylus->refcnt);
+		stylus = arena_alloc(&db->arena->objects, sizeof(*stylus));
+		stylus->details = arena_alloc(&db->arena->details,
+					      sizeof(*stylus->details));
 		stylus->id = id;
-		stylus->name = string_or_fallback(keyfile,
-						  groups[i],
-						  "Name",
-						  aliased ? aliased->name : NULL);
-		stylus->group = string_or_fallback(keyfile,
-						   groups[i],
-						   "Group",
-						   aliased ? aliased->group : NULL);
-		stylus->paired_stylus_ids =
-			g_array_new(FALSE, FALSE, sizeof(WacomStylusId));
+		name = string_or_fallback(keyfile,
+					  groups[i],
+					  "Name",
+					  aliased ? aliased->name : NULL);
+		stylus->name = libwacom_arena_intern(db->arena, name);
+		group = string_or_fallback(keyfile,
+					   groups[i],
+					   "Group",
+					   aliased ? aliased->details->group : NULL);
+		stylus->details->group = libwacom_arena_intern(db->arena, group);
+		paired_stylus_ids = g_array_new(FALSE, FALSE, sizeof(WacomStylusId));
 
 		eraser_type = string_or_fallback(
 			keyfile,
@@ -530,11 +539,6 @@ libwacom_parse_stylus_keyfile(WacomDeviceDatabase *db,
 			aliased ? eraser_str_from_type(aliased->eraser_type) : NULL);
 		stylus->eraser_type = eraser_type_from_str(eraser_type);
 
-		/* We have to keep the integer array for libwacom_get_supported_styli()
-		 */
-		stylus->deprecated_paired_ids = g_array_new(FALSE, FALSE, sizeof(int));
-		stylus->paired_styli = g_array_new(FALSE, FALSE, sizeof(WacomStylus *));
-
 		g_auto(GStrv) paired_id_list =
 			g_key_file_get_string_list(keyfile,
 						   groups[i],
@@ -542,22 +546,18 @@ libwacom_parse_stylus_keyfile(WacomDeviceDatabase *db,
 						   NULL,
 						   NULL);
 		if (handle_aliases != IGNORE_ALIASES) {
-			if (paired_id_list == NULL) {
+			if (paired_id_list == NULL && aliased) {
+				stylus->details->paired_from_alias = TRUE;
 				paired_id_list = stylus_ids_as_hex(
-					aliased ? aliased->paired_stylus_ids : NULL);
+					aliased->details->paired_stylus_ids,
+					aliased->details->num_paired_stylus_ids);
 			}
 		}
 
 		for (guint j = 0; paired_id_list && paired_id_list[j]; j++) {
 			WacomStylusId paired_id;
 			if (parse_stylus_id(paired_id_list[j], &paired_id)) {
-				g_array_append_val(stylus->paired_stylus_ids,
-						   paired_id);
-				if (paired_id.vid == 0 ||
-				    paired_id.vid == WACOM_VENDOR_ID)
-					g_array_append_val(
-						stylus->deprecated_paired_ids,
-						paired_id.tool_id);
+				g_array_append_val(paired_stylus_ids, paired_id);
 			} else {
 				g_warning(
 					"Stylus %s (%s) Ignoring invalid PairedStylusIds value\n",
@@ -565,6 +565,12 @@ libwacom_parse_stylus_keyfile(WacomDeviceDatabase *db,
 					groups[i]);
 			}
 		}
+		stylus->details->num_paired_stylus_ids = paired_stylus_ids->len;
+		stylus->details->paired_stylus_ids =
+			arena_memdup(&db->arena->details,
+				     paired_stylus_ids->data,
+				     paired_stylus_ids->len * sizeof(WacomStylusId));
+		stylus->details->arena = db->arena;
 
 		stylus->has_lens =
 			boolean_or_fallback(keyfile,
@@ -658,7 +664,7 @@ libwacom_parse_stylus_keyfile(WacomDeviceDatabase *db,
 		if (g_hash_table_lookup(db->stylus_ht, &id) != NULL)
 			g_warning("Duplicate definition for stylus ID '%s'", groups[i]);
 
-		g_hash_table_insert(db->stylus_ht, g_memdup2(&id, sizeof(id)), stylus);
+		g_hash_table_replace(db->stylus_ht, &stylus->id, stylus);
 	}
 }
 
@@ -671,12 +677,10 @@ libwacom_setup_paired_attributes(WacomDeviceDatabase *db)
 	g_hash_table_iter_init(&iter, db->stylus_ht);
 	while (g_hash_table_iter_next(&iter, &key, &value)) {
 		WacomStylus *stylus = value;
-		g_autoptr(GArray) paired_ids =
-			g_steal_pointer(&stylus->paired_stylus_ids);
+		g_autoptr(GPtrArray) paired_styli = g_ptr_array_new();
 
-		for (guint i = 0; i < paired_ids->len; i++) {
-			WacomStylusId *id =
-				&g_array_index(paired_ids, WacomStylusId, i);
+		for (guint i = 0; i < stylus->details->num_paired_stylus_ids; i++) {
+			WacomStylusId *id = &stylus->details->paired_stylus_ids[i];
 			WacomStylus *paired = g_hash_table_lookup(db->stylus_ht, id);
 
 			if (paired == NULL) {
@@ -686,12 +690,220 @@ libwacom_setup_paired_attributes(WacomDeviceDatabase *db)
 				continue;
 			}
 
-			g_array_append_val(stylus->paired_styli, paired);
+			g_ptr_array_add(paired_styli, paired);
 
 			if (libwacom_stylus_is_eraser(paired)) {
 				stylus->has_eraser = true;
 			}
 		}
+
+		stylus->num_paired_styli = paired_styli->len;
+		stylus->paired_styli =
+			arena_memdup(&db->arena->objects,
+				     paired_styli->pdata,
+				     paired_styli->len * sizeof(WacomStylus *));
+	}
+}
+
+/* The styli are complete, has_eraser is only set up by
+ * libwacom_setup_paired_attributes() */
+static void
+libwacom_setup_stylus_summaries(WacomDeviceDatabase *db)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, db->styli_sets);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		WacomStyliSet *set = value;
+		WacomStylusSummary *summary = &set->summary;
+
+		summary->num_styli = set->num_styli;
+		summary->axes_all = set->num_styli > 0 ? ~0 : WACOM_AXIS_TYPE_NONE;
+
+		for (guint i = 0; i < set->num_styli; i++) {
+			const WacomStylus *stylus = set->styli[i];
+			int num_buttons = stylus_num_buttons_or_default(stylus);
+			WacomStylusType type = stylus_type_or_default(stylus);
+
+			summary->axes_any |= stylus->axes;
+			summary->axes_all &= stylus->axes;
+			summary->max_buttons = MAX(summary->max_buttons, num_buttons);
+			summary->has_eraser |= stylus->has_eraser;
+			summary->has_lens |= stylus->has_lens;
+			summary->has_wheel |= stylus->has_wheel;
+			summary->eraser_types |= 1U << stylus->eraser_type;
+			summary->types |= 1U << type;
+		}
+	}
+}
+
+/* Numbers the styli for the bitsets of WacomStylusResolver */
+static void
+libwacom_index_styli(WacomDeviceDatabase *db)
+{
+	GHashTableIter iter;
+	gpointer value;
+	guint index = 0;
+
+	g_hash_table_iter_init(&iter, db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		WacomStylus *stylus = value;
+
+		stylus->index = index++;
+	}
+}
+
+static int
+wacom_stylus_id_sort(const WacomStylusId *a,
+		     const WacomStylusId *b)
+{
+	if (a->vid == b->vid)
+		return a->tool_id - b->tool_id;
+
+	return a->vid - b->vid;
+}
+
+static int
+styli_id_sort(gconstpointer pa,
+	      gconstpointer pb)
+{
+	const WacomStylus *a = *(WacomStylus **)pa, *b = *(WacomStylus **)pb;
+
+	return wacom_stylus_id_sort(&a->id, &b->id);
+}
+
+static gboolean
+stylus_is_paired_with(const WacomStylus *stylus,
+		      const WacomStylus *other)
+{
+	for (guint i = 0; i < stylus->num_paired_styli; i++) {
+		if (stylus->paired_styli[i] == other)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Picks the eraser of each pen and the pen of each eraser from their
+ * paired styli, so flipping the tool doesn't need a search. A pairing
+ * listed on one side only still applies both ways. */
+static void
+libwacom_pair_pens_and_erasers(WacomDeviceDatabase *db)
+{
+	guint num_styli = g_hash_table_size(db->stylus_ht);
+
+	/* In id order, so of several pens listing the same eraser the
+	 * lowest id gets it, whatever the hash table order */
+	for (guint n = 0; n < num_styli; n++) {
+		WacomStylus *stylus = (WacomStylus *)db->stylus_table[n];
+		gboolean is_eraser = libwacom_stylus_is_eraser(stylus);
+
+		for (guint i = 0; i < stylus->num_paired_styli; i++) {
+			WacomStylus *paired = stylus->paired_styli[i];
+
+			if (libwacom_stylus_is_eraser(paired) == is_eraser)
+				continue;
+
+			if (is_eraser && !stylus->paired_pen)
+				stylus->paired_pen = paired;
+			else if (!is_eraser && !stylus->paired_eraser)
+				stylus->paired_eraser = paired;
+		}
+	}
+
+	for (guint n = 0; n < num_styli; n++) {
+		WacomStylus *stylus = (WacomStylus *)db->stylus_table[n];
+
+		/* An alias shares the pairing of the stylus it aliases */
+		for (guint i = 0; i < stylus->num_paired_styli; i++) {
+			WacomStylus *paired = stylus->paired_styli[i];
+
+			if (!stylus->details->paired_from_alias &&
+			    !stylus_is_paired_with(paired, stylus))
+				g_warning("Stylus %04x:%x is paired with %04x:%x but not vice versa",
+					  stylus->id.vid,
+					  stylus->id.tool_id,
+					  paired->id.vid,
+					  paired->id.tool_id);
+		}
+
+		if (stylus->paired_eraser && !stylus->paired_eraser->paired_pen)
+			stylus->paired_eraser->paired_pen = stylus;
+		if (stylus->paired_pen && !stylus->paired_pen->paired_eraser)
+			stylus->paired_pen->paired_eraser = stylus;
+	}
+}
+
+static gint
+device_compare(gconstpointer pa,
+	       gconstpointer pb)
+{
+	const WacomDevice *a = pa, *b = pb;
+	int cmp;
+
+	cmp = libwacom_get_vendor_id(a) - libwacom_get_vendor_id(b);
+	if (cmp == 0)
+		cmp = libwacom_get_product_id(a) - libwacom_get_product_id(b);
+	if (cmp == 0)
+		cmp = g_strcmp0(libwacom_get_name(a), libwacom_get_name(b));
+	return cmp;
+}
+
+static gint
+device_ptr_compare(gconstpointer pa,
+		   gconstpointer pb)
+{
+	return device_compare(*(WacomDevice **)pa, *(WacomDevice **)pb);
+}
+
+/* The reverse of the device's styli, for libwacom_stylus_list_devices() */
+static void
+libwacom_setup_stylus_devices(WacomDeviceDatabase *db)
+{
+	g_autoptr(GHashTable) seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_autoptr(GHashTable) stylus_devices =
+		g_hash_table_new_full(g_direct_hash,
+				      g_direct_equal,
+				      NULL,
+				      (GDestroyNotify)g_ptr_array_unref);
+	g_autoptr(GPtrArray) devices = g_ptr_array_new();
+	GHashTableIter iter;
+	gpointer key, value;
+
+	/* Devices may be in the device_ht more than once */
+	g_hash_table_iter_init(&iter, db->device_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		if (g_hash_table_add(seen, value))
+			g_ptr_array_add(devices, value);
+	}
+	g_ptr_array_sort(devices, device_ptr_compare);
+
+	for (guint i = 0; i < devices->len; i++) {
+		WacomDevice *device = g_ptr_array_index(devices, i);
+
+		for (guint j = 0; j < device->styli->num_styli; j++) {
+			WacomStylus *stylus = device->styli->styli[j];
+			GPtrArray *array = g_hash_table_lookup(stylus_devices, stylus);
+
+			if (!array) {
+				array = g_ptr_array_new();
+				g_hash_table_insert(stylus_devices, stylus, array);
+			}
+			g_ptr_array_add(array, device);
+		}
+	}
+
+	g_hash_table_iter_init(&iter, stylus_devices);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		WacomStylusDetails *details = ((WacomStylus *)key)->details;
+		GPtrArray *array = value;
+
+		details->num_devices = array->len;
+		g_ptr_array_add(array, NULL);
+		details->devices = arena_memdup(&db->arena->details,
+						array->pdata,
+						array->len * sizeof(WacomDevice *));
 	}
 }
 
@@ -762,14 +974,9 @@ libwacom_parse_buttons_key(WacomDevice *device,
 			continue;
 		}
 
-		button = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(val));
-		if (!button) {
-			button = g_new0(WacomButton, 1);
+		button = &device->details->buttons[val - 'A'];
+		if (button->flags == WACOM_BUTTON_NONE)
 			button->mode = WACOM_MODE_SWITCH_NEXT;
-			g_hash_table_insert(device->buttons,
-					    GINT_TO_POINTER(val),
-					    button);
-		}
 
 		button->flags |= flag;
 
@@ -784,13 +991,52 @@ libwacom_parse_buttons_key(WacomDevice *device,
 	}
 }
 
+/* Called whenever the button codes change. If two buttons share a code,
+ * the first one wins */
+static void
+index_button_codes(WacomDevice *device)
+{
+	WacomDeviceDetails *details = device->details;
+
+	memset(details->button_for_code, 0, sizeof(details->button_for_code));
+
+	for (int i = WACOM_MAX_BUTTONS - 1; i >= 0; i--) {
+		const WacomButton *button = &details->buttons[i];
+		unsigned int idx = button->code - WACOM_BUTTON_CODE_MIN;
+
+		if (button->flags != WACOM_BUTTON_NONE && idx < WACOM_NUM_BUTTON_CODES)
+			details->button_for_code[idx] = 'A' + i;
+	}
+}
+
 static void
-reset_code(gpointer key,
-	   gpointer value,
-	   gpointer user_data)
+index_key_codes(WacomDevice *device)
 {
-	WacomButton *button = value;
-	button->code = 0;
+	WacomDeviceDetails *details = device->details;
+
+	memset(details->key_for_code, 0, sizeof(details->key_for_code));
+
+	for (guint i = 0; i < details->num_keycodes; i++) {
+		const WacomKeycode *key = &details->keycodes[i];
+		guint slot = wacom_keycode_slot(key->type, key->code);
+
+		/* Cleared after a parse error, or the KEY_RESERVED
+		 * placeholder which is never sent */
+		if (key->type == 0 || (key->type == EV_KEY && key->code == 0))
+			continue;
+
+		while (details->key_for_code[slot] != 0) {
+			const WacomKeycode *other =
+				&details->keycodes[details->key_for_code[slot] - 1];
+
+			if (other->type == key->type && other->code == key->code)
+				break;
+			slot = (slot + 1) % WACOM_KEYCODE_SLOTS;
+		}
+
+		if (details->key_for_code[slot] == 0)
+			details->key_for_code[slot] = i + 1;
+	}
 }
 
 static inline bool
@@ -801,14 +1047,13 @@ set_button_codes_from_string(WacomDevice *device,
 
 	assert(strvals);
 
-	for (guint i = 0; i < g_hash_table_size(device->buttons); i++) {
+	for (int i = 0; i < device->num_buttons; i++) {
 		char key = 'A' + i;
 		int code = -1;
-		WacomButton *button =
-			g_hash_table_lookup(device->buttons, GINT_TO_POINTER(key));
+		WacomButton *button = &device->details->buttons[i];
 		const char *str = strvals[i];
 
-		if (!button) {
+		if (button->flags == WACOM_BUTTON_NONE) {
 			g_error("%s: Button %c is not defined, ignoring all codes\n",
 				device->name,
 				key);
@@ -840,8 +1085,11 @@ set_button_codes_from_string(WacomDevice *device,
 	success = true;
 
 out:
-	if (!success)
-		g_hash_table_foreach(device->buttons, reset_code, NULL);
+	if (!success) {
+		for (guint i = 0; i < WACOM_MAX_BUTTONS; i++)
+			device->details->buttons[i].code = 0;
+	}
+	index_button_codes(device);
 
 	return success;
 }
@@ -858,7 +1106,7 @@ set_key_codes_from_string(WacomDevice *device,
 		int code = -1;
 		int type = -1;
 
-		if (idx >= G_N_ELEMENTS(device->keycodes)) {
+		if (idx >= G_N_ELEMENTS(device->details->keycodes)) {
 			g_warning("%s: Too many KeyCodes, ignoring all codes\n",
 				  device->name);
 			goto out;
@@ -887,16 +1135,18 @@ set_key_codes_from_string(WacomDevice *device,
 			goto out;
 		}
 
-		device->keycodes[idx].type = type;
-		device->keycodes[idx].code = code;
-		device->num_keycodes = idx + 1;
+		device->details->keycodes[idx].type = type;
+		device->details->keycodes[idx].code = code;
+		device->details->num_keycodes = idx + 1;
 	}
 
 	success = true;
 out:
 	if (!success) {
-		memset(device->keycodes, 0, sizeof(device->keycodes));
+		memset(device->details->keycodes, 0, sizeof(device->details->keycodes));
 	}
+	index_key_codes(device);
+
 	return success;
 }
 
@@ -905,10 +1155,9 @@ set_button_codes_from_heuristics(WacomDevice *device)
 {
 	for (char key = 'A'; key <= 'Z'; key++) {
 		int code = 0;
-		WacomButton *button;
+		WacomButton *button = &device->details->buttons[key - 'A'];
 
-		button = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(key));
-		if (!button)
+		if (button->flags == WACOM_BUTTON_NONE)
 			continue;
 
 		if (device->cls == WCLASS_BAMBOO || device->cls == WCLASS_GRAPHIRE) {
@@ -997,6 +1246,8 @@ set_button_codes_from_heuristics(WacomDevice *device)
 
 		button->code = code;
 	}
+
+	index_button_codes(device);
 }
 
 static void
@@ -1018,18 +1269,14 @@ libwacom_parse_num_modes(WacomDevice *device,
 			 const char *key,
 			 WacomButtonFlags flag)
 {
-	GHashTableIter iter;
 	int num;
-	gpointer k, v;
 
 	num = g_key_file_get_integer(keyfile, BUTTONS_GROUP, key, NULL);
 	if (num > 0)
 		return num;
 
-	g_hash_table_iter_init(&iter, device->buttons);
-	while (g_hash_table_iter_next(&iter, &k, &v)) {
-		WacomButton *button = v;
-		if (button->flags & flag)
+	for (guint i = 0; i < WACOM_MAX_BUTTONS; i++) {
+		if (device->details->buttons[i].flags & flag)
 			num++;
 	}
 
@@ -1051,6 +1298,11 @@ libwacom_parse_buttons(WacomDevice *device,
 					   options[i].key,
 					   options[i].flag);
 
+	for (i = 0; i < WACOM_MAX_BUTTONS; i++) {
+		if (device->details->buttons[i].flags != WACOM_BUTTON_NONE)
+			device->num_buttons++;
+	}
+
 	libwacom_parse_button_codes(device, keyfile);
 
 	device->ring_num_modes = libwacom_parse_num_modes(device,
@@ -1099,31 +1351,14 @@ libwacom_parse_keys(WacomDevice *device,
 	libwacom_parse_key_codes(device, keyfile);
 }
 
-static int
-wacom_stylus_id_sort(const WacomStylusId *a,
-		     const WacomStylusId *b)
-{
-	if (a->vid == b->vid)
-		return a->tool_id - b->tool_id;
-
-	return a->vid - b->vid;
-}
-
-static int
-styli_id_sort(gconstpointer pa,
-	      gconstpointer pb)
-{
-	const WacomStylus *a = *(WacomStylus **)pa, *b = *(WacomStylus **)pb;
-
-	return wacom_stylus_id_sort(&a->id, &b->id);
-}
-
 static void
 libwacom_parse_styli_list(WacomDeviceDatabase *db,
 			  WacomDevice *device,
 			  char **ids)
 {
-	GArray *array;
+	g_autoptr(GArray) array = NULL;
+	g_autoptr(GBytes) styli_key = NULL;
+	WacomStyliSet *set;
 	guint i;
 
 	array = g_array_new(FALSE, FALSE, sizeof(WacomStylus *));
@@ -1154,8 +1389,8 @@ libwacom_parse_styli_list(WacomDeviceDatabase *db,
 			g_hash_table_iter_init(&iter, db->stylus_ht);
 			while (g_hash_table_iter_next(&iter, &key, &value)) {
 				WacomStylus *stylus = value;
-				if (stylus->group &&
-				    g_str_equal(group, stylus->group)) {
+				if (stylus->details->group &&
+				    g_str_equal(group, stylus->details->group)) {
 					g_array_append_val(array, stylus);
 				}
 			}
@@ -1166,22 +1401,32 @@ libwacom_parse_styli_list(WacomDeviceDatabase *db,
 	/* Using groups means we don't get the styli in ascending order.
 	   Sort it so the output is predictable */
 	g_array_sort(array, styli_id_sort);
-	device->styli = array;
-
-	/* The legacy PID-only stylus id list */
-	device->deprecated_styli_ids = g_array_new(FALSE, FALSE, sizeof(int));
-	for (guint i = 0; i < device->styli->len; i++) {
-		WacomStylus *stylus = g_array_index(device->styli, WacomStylus *, i);
-		/* This only ever worked for Wacom styli, so let's keep that behavior */
-		if (stylus->id.vid == 0 || stylus->id.vid == WACOM_VENDOR_ID) {
-			g_array_append_val(device->deprecated_styli_ids,
-					   stylus->id.tool_id);
-		}
+
+	/* Most devices list the same few groups, share the sets */
+	styli_key = g_bytes_new_static(array->data, array->len * sizeof(WacomStylus *));
+	set = g_hash_table_lookup(db->styli_sets, styli_key);
+	if (set) {
+		device->styli = set;
+		return;
 	}
+
+	set = arena_alloc(&db->arena->objects, sizeof(*set));
+	set->num_styli = array->len;
+	set->styli = arena_memdup(&db->arena->objects,
+				  array->data,
+				  array->len * sizeof(WacomStylus *));
+	set->arena = db->arena;
+
+	g_hash_table_insert(db->styli_sets,
+			    g_bytes_new_static(set->styli,
+					       set->num_styli * sizeof(WacomStylus *)),
+			    set);
+	device->styli = set;
 }
 
 static void
-libwacom_parse_features(WacomDevice *device,
+libwacom_parse_features(WacomDeviceDatabase *db,
+			WacomDevice *device,
 			GKeyFile *keyfile)
 {
 	/* Features */
@@ -1224,13 +1469,16 @@ libwacom_parse_features(WacomDevice *device,
 							      NULL,
 							      NULL);
 	if (statusleds) {
+		WacomDeviceDetails *details = device->details;
 		guint i, n;
 
 		for (i = 0; statusleds[i]; i++) {
 			for (n = 0; n < G_N_ELEMENTS(supported_leds); n++) {
 				if (g_str_equal(statusleds[i], supported_leds[n].key)) {
-					g_array_append_val(device->status_leds,
-							   supported_leds[n].value);
+					if (details->num_status_leds <
+					    G_N_ELEMENTS(details->status_leds))
+						details->status_leds[details->num_status_leds++] =
+							supported_leds[n].value;
 					break;
 				}
 			}
@@ -1243,11 +1491,14 @@ libwacom_parse_tablet_keyfile(WacomDeviceDatabase *db,
 			      const char *datadir,
 			      const char *filename)
 {
-	g_autoptr(WacomDevice) device = NULL;
+	WacomDevice *device = NULL;
+	WacomDeviceDetails *details;
 	g_autoptr(GKeyFile) keyfile = NULL;
 	g_autoptr(GError) error = NULL;
 	gboolean rc;
 	g_autofree char *path = NULL;
+	g_autofree char *name = NULL;
+	g_autofree char *model_name = NULL;
 	g_autofree char *layout = NULL;
 	g_autofree char *class = NULL;
 	g_autofree char *paired = NULL;
@@ -1263,9 +1514,11 @@ libwacom_parse_tablet_keyfile(WacomDeviceDatabase *db,
 		return NULL;
 	}
 
-	device = g_new0(WacomDevice, 1);
-	g_atomic_ref_count_init(&device->refcnt);
-	device->matches = g_array_new(TRUE, TRUE, sizeof(WacomMatch *));
+	/* A file rejected below leaves its bits in the arena, that's
+	 * not worth the bookkeeping */
+	device = arena_alloc(&db->arena->objects, sizeof(*device));
+	details = arena_alloc(&db->arena->details, sizeof(*details));
+	device->details = details;
 
 	g_auto(GStrv) matches = g_key_file_get_string_list(keyfile,
 							   DEVICE_GROUP,
@@ -1276,59 +1529,69 @@ libwacom_parse_tablet_keyfile(WacomDeviceDatabase *db,
 		DBG("Missing DeviceMatch= line in '%s'\n", path);
 		return NULL;
 	} else {
+		g_autoptr(GPtrArray) device_matches = g_ptr_array_new();
 		guint i;
-		guint nmatches = 0;
+
 		for (i = 0; matches[i]; i++) {
-			g_autoptr(WacomMatch) m =
-				libwacom_match_from_string(matches[i]);
+			WacomMatch *m = libwacom_match_from_string(db, matches[i]);
+			bool duplicate = false;
+
 			if (!m) {
 				DBG("'%s' is an invalid DeviceMatch in '%s'\n",
 				    matches[i],
 				    path);
 				continue;
 			}
-			libwacom_add_match(device, m);
-			nmatches++;
-			/* set default to first entry */
-			if (nmatches == 1)
-				libwacom_set_default_match(device, m);
+			for (guint j = 0; j < device_matches->len; j++) {
+				WacomMatch *other = g_ptr_array_index(device_matches, j);
+				if (libwacom_match_equal(other, m))
+					duplicate = true;
+			}
+			if (!duplicate)
+				g_ptr_array_add(device_matches, m);
 		}
-		if (nmatches == 0) {
+		if (device_matches->len == 0) {
 			return NULL;
 		}
+
+		device->num_matches = device_matches->len;
+		g_ptr_array_add(device_matches, NULL);
+		device->matches =
+			arena_memdup(&db->arena->objects,
+				     device_matches->pdata,
+				     device_matches->len * sizeof(WacomMatch *));
+		/* set default to first entry */
+		device->match = device->matches[0];
 	}
 
 	paired = g_key_file_get_string(keyfile, DEVICE_GROUP, "PairedID", NULL);
 	if (paired) {
-		libwacom_matchstr_to_paired(device, paired);
+		libwacom_matchstr_to_paired(db, device, paired);
 	}
 
-	device->name = g_key_file_get_string(keyfile, DEVICE_GROUP, "Name", NULL);
-	device->model_name =
-		g_key_file_get_string(keyfile, DEVICE_GROUP, "ModelName", NULL);
+	name = g_key_file_get_string(keyfile, DEVICE_GROUP, "Name", NULL);
+	device->name = libwacom_arena_intern(db->arena, name);
+	model_name = g_key_file_get_string(keyfile, DEVICE_GROUP, "ModelName", NULL);
 	/* ModelName= would give us the empty string, let's make it NULL
 	 * instead */
-	if (device->model_name && strlen(device->model_name) == 0) {
-		g_free(device->model_name);
-		device->model_name = NULL;
-	}
-	device->width_mm = g_key_file_get_integer(keyfile, DEVICE_GROUP, "Width", NULL);
-	device->height_mm =
-		g_key_file_get_integer(keyfile, DEVICE_GROUP, "Height", NULL);
+	if (model_name && strlen(model_name) > 0)
+		device->model_name = libwacom_arena_intern(db->arena, model_name);
+	details->width_mm = g_key_file_get_integer(keyfile, DEVICE_GROUP, "Width", NULL);
+	details->height_mm = g_key_file_get_integer(keyfile, DEVICE_GROUP, "Height", NULL);
 
-	if (device->width_mm > 0 && device->width_mm < 20) {
+	if (details->width_mm > 0 && details->width_mm < 20) {
 		g_warning("%s: Width is %d, expected a value in mm. "
 			  "This .tablet file needs to be updated.",
 			  filename,
-			  device->width_mm);
-		device->width_mm = (int)(device->width_mm * 25.4 + 0.5);
+			  details->width_mm);
+		details->width_mm = (int)(details->width_mm * 25.4 + 0.5);
 	}
-	if (device->height_mm > 0 && device->height_mm < 20) {
+	if (details->height_mm > 0 && details->height_mm < 20) {
 		g_warning("%s: Height is %d, expected a value in mm. "
 			  "This .tablet file needs to be updated.",
 			  filename,
-			  device->height_mm);
-		device->height_mm = (int)(device->height_mm * 25.4 + 0.5);
+			  details->height_mm);
+		details->height_mm = (int)(details->height_mm * 25.4 + 0.5);
 	}
 
 	device->integration_flags = WACOM_DEVICE_INTEGRATED_UNSET;
@@ -1367,8 +1630,9 @@ libwacom_parse_tablet_keyfile(WacomDeviceDatabase *db,
 				  layout);
 		} else {
 			/* For the layout, we store the full path to the SVG layout */
-			device->layout =
+			g_autofree char *layout_path =
 				g_build_filename(datadir, "layouts", layout, NULL);
+			device->layout = libwacom_arena_intern(db->arena, layout_path);
 		}
 	}
 
@@ -1396,15 +1660,13 @@ libwacom_parse_tablet_keyfile(WacomDeviceDatabase *db,
 		g_key_file_get_integer(keyfile, FEATURES_GROUP, "NumStrips", NULL);
 	device->num_dials =
 		g_key_file_get_integer(keyfile, FEATURES_GROUP, "NumDials", NULL);
-	device->buttons =
-		g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
-	device->status_leds = g_array_new(FALSE, FALSE, sizeof(WacomStatusLEDs));
 
-	libwacom_parse_features(device, keyfile);
+	libwacom_parse_features(db, device, keyfile);
 	libwacom_parse_buttons(device, keyfile);
 	libwacom_parse_keys(device, keyfile);
+	libwacom_setup_button_led_groups(device);
 
-	return g_steal_pointer(&device);
+	return device;
 }
 
 static bool
@@ -1437,6 +1699,12 @@ is_stylus_file(const struct dirent *entry)
 	return has_suffix(entry->d_name, STYLUS_SUFFIX);
 }
 
+static int
+is_uniq_file(const struct dirent *entry)
+{
+	return has_suffix(entry->d_name, UNIQ_SUFFIX);
+}
+
 static bool
 load_tablet_files(WacomDeviceDatabase *db,
 		  GHashTable *parsed_filenames,
@@ -1452,7 +1720,6 @@ load_tablet_files(WacomDeviceDatabase *db,
 
 	while ((file = readdir(dir))) {
 		WacomDevice *d;
-		guint idx = 0;
 
 		if (!is_tablet_file(file))
 			continue;
@@ -1468,31 +1735,24 @@ load_tablet_files(WacomDeviceDatabase *db,
 			continue;
 		}
 
-		if (d->matches->len == 0) {
+		if (d->num_matches == 0) {
 			g_critical("Device '%s' has no matches defined\n",
 				   libwacom_get_name(d));
 			goto out;
 		}
 
-		/* Note: we may change the array while iterating over it */
-		while (idx < d->matches->len) {
-			WacomMatch *match =
-				g_array_index(d->matches, WacomMatch *, idx);
-			const char *matchstr;
+		for (guint idx = 0; idx < d->num_matches; idx++) {
+			WacomMatch *match = d->matches[idx];
 
-			matchstr = libwacom_match_get_match_string(match);
 			/* no duplicate matches allowed */
-			if (g_hash_table_contains(db->device_ht, matchstr)) {
+			if (g_hash_table_contains(db->device_ht, match)) {
 				g_critical("Duplicate match of '%s' on device '%s'.",
-					   matchstr,
+					   libwacom_match_get_match_string(match),
 					   libwacom_get_name(d));
 				goto out;
 			}
-			g_hash_table_insert(db->device_ht, g_strdup(matchstr), d);
-			libwacom_ref(d);
-			idx++;
+			g_hash_table_insert(db->device_ht, match, d);
 		}
-		libwacom_unref(d);
 	}
 
 	success = true;
@@ -1502,12 +1762,6 @@ out:
 	return success;
 }
 
-static void
-stylus_destroy(void *data)
-{
-	libwacom_stylus_unref((WacomStylus *)data);
-}
-
 static bool
 load_stylus_files(WacomDeviceDatabase *db,
 		  const char *datadir,
@@ -1535,6 +1789,90 @@ load_stylus_files(WacomDeviceDatabase *db,
 	return true;
 }
 
+static void
+libwacom_parse_uniq_keyfile(WacomDeviceDatabase *db,
+			    const char *path)
+{
+	g_autoptr(GKeyFile) keyfile = g_key_file_new();
+	g_autoptr(GError) error = NULL;
+	g_auto(GStrv) groups = NULL;
+
+	if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, &error)) {
+		g_warning("Failed to load uniq keyfile '%s': %s",
+			  path,
+			  error ? error->message : "unknown error");
+		return;
+	}
+
+	groups = g_key_file_get_groups(keyfile, NULL);
+	for (guint i = 0; groups[i]; i++) {
+		WacomUniqRule rule = { 0 };
+		g_autofree char *separator = NULL;
+		int min_fields, strip_fields;
+
+		separator = g_key_file_get_string(keyfile, groups[i], "Separator", NULL);
+		if (!separator || strlen(separator) != 1) {
+			g_warning("%s: rule '%s' needs a single-character Separator, ignoring",
+				  path,
+				  groups[i]);
+			continue;
+		}
+
+		strip_fields =
+			g_key_file_get_integer(keyfile, groups[i], "StripFields", NULL);
+		min_fields = g_key_file_get_integer(keyfile, groups[i], "MinFields", NULL);
+		if (strip_fields < 1 || min_fields < 0) {
+			g_warning("%s: rule '%s' has invalid StripFields or MinFields, ignoring",
+				  path,
+				  groups[i]);
+			continue;
+		}
+
+		rule.prefix = g_key_file_get_string(keyfile, groups[i], "Prefix", NULL);
+		rule.separator = separator[0];
+		rule.min_fields = min_fields;
+		rule.strip_fields = strip_fields;
+		g_array_append_val(db->uniq_rules, rule);
+	}
+}
+
+/* Rules are applied in the order of the datadirs, then the file names,
+ * then their order within the file */
+static bool
+load_uniq_files(WacomDeviceDatabase *db,
+		GHashTable *parsed_filenames,
+		const char *datadir)
+{
+	struct dirent **files;
+	int nfiles;
+
+	nfiles = scandir(datadir, &files, is_uniq_file, alphasort);
+	if (nfiles < 0)
+		return errno == ENOENT; /* non-existing directory is ok */
+
+	for (int i = 0; i < nfiles; i++) {
+		const char *name = files[i]->d_name;
+
+		/* A file in an earlier datadir overrides the same file later */
+		if (!g_hash_table_contains(parsed_filenames, name)) {
+			g_autofree char *path = g_build_filename(datadir, name, NULL);
+
+			g_hash_table_add(parsed_filenames, g_strdup(name));
+			libwacom_parse_uniq_keyfile(db, path);
+		}
+		free(files[i]);
+	}
+	free(files);
+
+	return true;
+}
+
+static void
+uniq_rule_clear(WacomUniqRule *rule)
+{
+	g_free(rule->prefix);
+}
+
 static guint
 stylus_hash(WacomStylusId *id)
 {
@@ -1549,6 +1887,132 @@ stylus_compare(WacomStylusId *a,
 	return wacom_stylus_id_sort(a, b) == 0;
 }
 
+WacomArena *
+libwacom_arena_new(void)
+{
+	WacomArena *arena = g_new0(WacomArena, 1);
+
+	g_atomic_ref_count_init(&arena->refcnt);
+	arena->interned = g_hash_table_new(g_str_hash, g_str_equal);
+	g_mutex_init(&arena->lock);
+
+	return arena;
+}
+
+WacomArena *
+libwacom_arena_ref(WacomArena *arena)
+{
+	g_atomic_ref_count_inc(&arena->refcnt);
+	return arena;
+}
+
+WacomArena *
+libwacom_arena_unref(WacomArena *arena)
+{
+	if (arena == NULL || !g_atomic_ref_count_dec(&arena->refcnt))
+		return NULL;
+
+	g_hash_table_destroy(arena->interned);
+	if (arena->image)
+		munmap(arena->image, arena->image_size);
+	arena_release(&arena->strings);
+	arena_release(&arena->objects);
+	arena_release(&arena->details);
+	g_mutex_clear(&arena->lock);
+	g_free(arena);
+
+	return NULL;
+}
+
+/* Only called while the database is being parsed, later the
+ * string set is read-only and may be shared between threads */
+const char *
+libwacom_arena_intern(WacomArena *arena,
+		      const char *str)
+{
+	char *interned;
+
+	if (str == NULL)
+		return NULL;
+
+	interned = g_hash_table_lookup(arena->interned, str);
+	if (!interned) {
+		interned = arena_strdup(&arena->strings, str);
+		g_hash_table_add(arena->interned, interned);
+	}
+
+	return interned;
+}
+
+/* Returns the interned copy of str or NULL if the database doesn't
+ * have that string anywhere */
+const char *
+libwacom_arena_lookup(const WacomArena *arena,
+		      const char *str)
+{
+	if (str == NULL)
+		return NULL;
+
+	return g_hash_table_lookup(arena->interned, str);
+}
+
+/* Called once the stylus_ht is complete */
+void
+libwacom_database_build_stylus_table(WacomDeviceDatabase *db)
+{
+	g_autoptr(GArray) vendors = g_array_new(FALSE, FALSE, sizeof(WacomVendorStyli));
+	guint num_styli = g_hash_table_size(db->stylus_ht);
+	GHashTableIter iter;
+	gpointer value;
+	guint i = 0;
+
+	db->stylus_table = g_new0(const WacomStylus *, num_styli);
+	g_hash_table_iter_init(&iter, db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		db->stylus_table[i++] = value;
+	qsort(db->stylus_table, num_styli, sizeof(*db->stylus_table), styli_id_sort);
+
+	for (i = 0; i < num_styli; i++) {
+		const WacomStylus *stylus = db->stylus_table[i];
+
+		if (vendors->len == 0 ||
+		    g_array_index(vendors, WacomVendorStyli, vendors->len - 1).vid !=
+			    stylus->id.vid) {
+			WacomVendorStyli vendor = {
+				.vid = stylus->id.vid,
+				.styli = &db->stylus_table[i],
+			};
+			g_array_append_val(vendors, vendor);
+		}
+		g_array_index(vendors, WacomVendorStyli, vendors->len - 1).num_styli++;
+	}
+
+	db->num_vendors = vendors->len;
+	db->vendors = (WacomVendorStyli *)g_array_free(g_steal_pointer(&vendors), FALSE);
+}
+
+/* A database without devices or styli yet */
+WacomDeviceDatabase *
+libwacom_database_alloc(void)
+{
+	WacomDeviceDatabase *db;
+
+	db = g_new0(WacomDeviceDatabase, 1);
+	g_atomic_ref_count_init(&db->refcnt);
+	g_mutex_init(&db->path_cache_lock);
+	db->path_requests = g_hash_table_new(g_str_hash, g_str_equal);
+	db->udev = &udev_backend_gudev;
+	db->arena = libwacom_arena_new();
+	/* Devices, styli and the matches used as keys are in the arena */
+	db->device_ht = g_hash_table_new(libwacom_match_hash, libwacom_match_equal);
+	db->stylus_ht = g_hash_table_new((GHashFunc)stylus_hash,
+					 (GEqualFunc)stylus_compare);
+	db->uniq_rules = g_array_new(FALSE, FALSE, sizeof(WacomUniqRule));
+	g_array_set_clear_func(db->uniq_rules, (GDestroyNotify)uniq_rule_clear);
+
+	return db;
+}
+
 static WacomDeviceDatabase *
 database_new_for_paths(char *const *datadirs)
 {
@@ -1560,16 +2024,11 @@ database_new_for_paths(char *const *datadirs)
 	if (!parsed_filenames)
 		return NULL;
 
-	db = g_new0(WacomDeviceDatabase, 1);
-	g_atomic_ref_count_init(&db->refcnt);
-	db->device_ht = g_hash_table_new_full(g_str_hash,
-					      g_str_equal,
-					      g_free,
-					      (GDestroyNotify)libwacom_destroy);
-	db->stylus_ht = g_hash_table_new_full((GHashFunc)stylus_hash,
-					      (GEqualFunc)stylus_compare,
-					      (GDestroyNotify)g_free,
-					      (GDestroyNotify)stylus_destroy);
+	db = libwacom_database_alloc();
+	db->styli_sets = g_hash_table_new_full(g_bytes_hash,
+					       g_bytes_equal,
+					       (GDestroyNotify)g_bytes_unref,
+					       NULL);
 
 	for (datadir = datadirs; *datadir; datadir++) {
 		if (!load_stylus_files(db, *datadir, IGNORE_ALIASES))
@@ -1586,6 +2045,11 @@ database_new_for_paths(char *const *datadirs)
 			goto error;
 	}
 
+	for (datadir = datadirs; *datadir; datadir++) {
+		if (!load_uniq_files(db, parsed_filenames, *datadir))
+			goto error;
+	}
+
 	/* If we couldn't load _anything_ then something's wrong */
 	if (g_hash_table_size(db->stylus_ht) == 0 ||
 	    g_hash_table_size(db->device_ht) == 0) {
@@ -1594,6 +2058,12 @@ database_new_for_paths(char *const *datadirs)
 	}
 
 	libwacom_setup_paired_attributes(db);
+	libwacom_database_build_stylus_table(db);
+	libwacom_pair_pens_and_erasers(db);
+	libwacom_setup_stylus_devices(db);
+	libwacom_setup_stylus_summaries(db);
+	libwacom_index_styli(db);
+	g_clear_pointer(&db->styli_sets, g_hash_table_destroy);
 
 	return db;
 
@@ -1657,28 +2127,218 @@ libwacom_database_unref(WacomDeviceDatabase *db)
 	if (db == NULL || !g_atomic_ref_count_dec(&db->refcnt))
 		return NULL;
 
-	if (db->device_ht)
-		g_hash_table_destroy(db->device_ht);
-	if (db->stylus_ht)
-		g_hash_table_destroy(db->stylus_ht);
+	g_clear_pointer(&db->path_cache, g_hash_table_destroy);
+	g_mutex_clear(&db->path_cache_lock);
+	/* Each in-flight request holds a reference, so this is empty */
+	g_clear_pointer(&db->path_requests, g_hash_table_destroy);
+	g_hash_table_destroy(db->device_ht);
+	g_hash_table_destroy(db->stylus_ht);
+	g_clear_pointer(&db->uniq_rules, g_array_unref);
+	g_free(db->stylus_table);
+	g_free(db->vendors);
+	g_clear_pointer(&db->styli_sets, g_hash_table_destroy);
+	/* Copies of our devices may still hold a reference */
+	libwacom_arena_unref(db->arena);
 	g_free(db);
 
 	return NULL;
 }
 
-static gint
-device_compare(gconstpointer pa,
-	       gconstpointer pb)
+LIBWACOM_EXPORT void
+libwacom_database_set_path_cache(WacomDeviceDatabase *db,
+				 int enabled)
 {
-	const WacomDevice *a = pa, *b = pb;
-	int cmp;
+	GHashTable *cache = NULL;
 
-	cmp = libwacom_get_vendor_id(a) - libwacom_get_vendor_id(b);
-	if (cmp == 0)
-		cmp = libwacom_get_product_id(a) - libwacom_get_product_id(b);
-	if (cmp == 0)
-		cmp = g_strcmp0(libwacom_get_name(a), libwacom_get_name(b));
-	return cmp;
+	g_mutex_lock(&db->path_cache_lock);
+	if (enabled && !db->path_cache) {
+		cache = g_hash_table_new_full(g_str_hash,
+					      g_str_equal,
+					      g_free,
+					      (GDestroyNotify)path_cache_entry_free);
+		g_atomic_pointer_set(&db->path_cache, cache);
+		cache = NULL;
+	} else if (!enabled) {
+		cache = g_steal_pointer(&db->path_cache);
+	}
+	g_mutex_unlock(&db->path_cache_lock);
+
+	/* Dropping the device references may take a while */
+	if (cache)
+		g_hash_table_destroy(cache);
+}
+
+/* GHashTable keeps its size a power of two with no more than three
+ * quarters in use, with a key, a value and a hash per slot */
+static void
+add_hash_table_stats(WacomDatabaseStats *stats,
+		     GHashTable *ht)
+{
+	size_t slots = 8;
+
+	if (!ht)
+		return;
+
+	while (slots * 3 / 4 < g_hash_table_size(ht))
+		slots *= 2;
+
+	stats->num_hash_tables++;
+	stats->hash_table_bytes += slots * (2 * sizeof(gpointer) + sizeof(guint));
+}
+
+static void
+add_string_stats(WacomDatabaseStats *stats,
+		 const char *str)
+{
+	if (!str)
+		return;
+
+	stats->num_strings++;
+	stats->strings_bytes += strlen(str) + 1;
+}
+
+LIBWACOM_EXPORT WacomDatabaseStats *
+libwacom_database_get_stats(WacomDeviceDatabase *db)
+{
+	WacomDatabaseStats *stats = g_new0(WacomDatabaseStats, 1);
+	g_autoptr(GHashTable) seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GHashTableIter iter;
+	gpointer key, value;
+
+	/* Devices and styli may be in their tables more than once */
+	g_hash_table_iter_init(&iter, db->device_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		WacomDevice *device = value;
+		WacomDeviceDetails *details = device->details;
+		WacomStyliSet *set = (WacomStyliSet *)device->styli;
+
+		if (!g_hash_table_add(seen, value))
+			continue;
+
+		stats->num_devices++;
+		stats->devices_bytes += sizeof(*device) + sizeof(*details) -
+					sizeof(details->buttons);
+		stats->num_buttons += device->num_buttons;
+		stats->buttons_bytes += sizeof(details->buttons);
+
+		stats->matches_bytes +=
+			(device->num_matches + 1) * sizeof(*device->matches);
+		for (guint i = 0; i < device->num_matches; i++) {
+			WacomMatch *match = device->matches[i];
+
+			if (!g_hash_table_add(seen, match))
+				continue;
+
+			stats->num_matches++;
+			stats->matches_bytes += sizeof(*match);
+			/* Formatted on first use, not interned */
+			add_string_stats(stats, g_atomic_pointer_get(&match->match));
+		}
+
+		if (g_hash_table_add(seen, set)) {
+			stats->styli_bytes += sizeof(*set);
+			stats->styli_bytes += set->num_styli * sizeof(*set->styli);
+			if (g_atomic_pointer_get(&set->deprecated_ids_once))
+				stats->styli_bytes +=
+					set->num_deprecated_ids * sizeof(int);
+		}
+	}
+
+	g_hash_table_iter_init(&iter, db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		WacomStylus *stylus = value;
+		WacomStylusDetails *details = stylus->details;
+
+		if (!g_hash_table_add(seen, value))
+			continue;
+
+		stats->num_styli++;
+		stats->styli_bytes += sizeof(*stylus) + sizeof(*details);
+		stats->styli_bytes +=
+			stylus->num_paired_styli * sizeof(*stylus->paired_styli);
+		stats->styli_bytes += details->num_paired_stylus_ids *
+				      sizeof(*details->paired_stylus_ids);
+		if (details->devices)
+			stats->styli_bytes +=
+				(details->num_devices + 1) * sizeof(*details->devices);
+		if (g_atomic_pointer_get(&details->deprecated_paired_ids_once))
+			stats->styli_bytes +=
+				details->num_deprecated_paired_ids * sizeof(int);
+	}
+
+	g_hash_table_iter_init(&iter, db->arena->interned);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		add_string_stats(stats, key);
+
+	add_hash_table_stats(stats, db->device_ht);
+	add_hash_table_stats(stats, db->stylus_ht);
+	add_hash_table_stats(stats, db->arena->interned);
+	g_mutex_lock(&db->path_cache_lock);
+	add_hash_table_stats(stats, db->path_cache);
+	g_mutex_unlock(&db->path_cache_lock);
+	libwacom_path_requests_lock();
+	add_hash_table_stats(stats, db->path_requests);
+	libwacom_path_requests_unlock();
+
+	stats->num_handles = g_atomic_int_get(&db->arena->live_devices);
+	stats->handles_bytes = stats->num_handles * sizeof(WacomDevice);
+
+	g_mutex_lock(&db->arena->lock);
+	stats->arena_bytes = arena_size(&db->arena->strings) +
+			     arena_size(&db->arena->objects) +
+			     arena_size(&db->arena->details) + db->arena->image_size;
+	g_mutex_unlock(&db->arena->lock);
+
+	return stats;
+}
+
+/* Builds everything that is otherwise built on first use, later calls
+ * only read it */
+void
+libwacom_database_build_lazy(WacomDeviceDatabase *db)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, db->device_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		WacomDevice *device = value;
+		guint count;
+
+		for (guint i = 0; i < device->num_matches; i++)
+			libwacom_match_get_match_string(device->matches[i]);
+		if (device->paired)
+			libwacom_match_get_match_string(device->paired);
+		libwacom_styli_set_get_deprecated_ids((WacomStyliSet *)device->styli,
+						      &count);
+	}
+
+	g_hash_table_iter_init(&iter, db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		guint count;
+
+		libwacom_stylus_get_deprecated_paired_ids(value, &count);
+	}
+}
+
+LIBWACOM_EXPORT int
+libwacom_database_freeze(WacomDeviceDatabase *db)
+{
+	WacomArena *arena = db->arena;
+	gboolean success;
+
+	libwacom_database_build_lazy(db);
+
+	g_mutex_lock(&arena->lock);
+	success = arena_protect(&arena->strings) && arena_protect(&arena->objects) &&
+		  arena_protect(&arena->details);
+	g_mutex_unlock(&arena->lock);
+
+	if (!success)
+		g_warning("Failed to make the database read-only: %s",
+			  g_strerror(errno));
+
+	return success;
 }
 
 static void
@@ -0,0 +1,1065 @@
+/*
+ * Copyright © 2025 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/* A database image holds the devices, styli, matches and strings of a
+ * loaded database in a sealed memfd. Other processes can map it instead
+ * of parsing the data files again.
+ *
+ * The image holds no addresses, its pointer fields are offsets from the
+ * start of the image. Every process maps the same read-only pages
+ * wherever they land. Strings, device details and plain arrays are used
+ * in place, the small objects that point to each other (devices,
+ * matches, styli and styli sets) are copied into the database's arena
+ * with their offsets resolved.
+ */
+
+#include "config.h"
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libwacomint.h"
+
+#define IMAGE_MAGIC "LWDBIMG"
+/* Bump when the image layout changes in a way the struct sizes in
+ * the header don't catch */
+#define IMAGE_VERSION 1
+#define IMAGE_ALIGN alignof(union arena_align)
+
+struct image_table {
+	uint64_t offset;
+	uint64_t count;
+};
+
+struct image_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	/* The image is only valid with the same struct layout */
+	uint32_t pointer_size;
+	uint32_t device_size;
+	uint32_t device_details_size;
+	uint32_t match_size;
+	uint32_t stylus_size;
+	uint32_t stylus_details_size;
+	uint32_t styli_set_size;
+	uint32_t uniq_rule_size;
+	uint64_t size; /* of the whole image, the header included */
+	struct image_table entries;    /* struct image_entry, the device_ht */
+	struct image_table styli;      /* uintptr_t, the stylus_ht */
+	struct image_table strings;    /* uintptr_t, the interned strings */
+	struct image_table uniq_rules; /* WacomUniqRule */
+};
+
+/* Offsets like all pointers in the image */
+struct image_entry {
+	uintptr_t match;
+	uintptr_t device;
+};
+
+#if HAVE_MEMFD_CREATE
+
+struct image_writer {
+	GByteArray *data;
+	GHashTable *offsets; /* source object -> offset in data */
+};
+
+typedef gsize (*image_add_func)(struct image_writer *w,
+				const void *src);
+
+/* Returns the offset of the copy, the data is zeroed if src is NULL */
+static gsize
+image_append(struct image_writer *w,
+	     const void *src,
+	     gsize size,
+	     gsize align)
+{
+	gsize offset = (w->data->len + align - 1) & ~(align - 1);
+
+	g_byte_array_set_size(w->data, offset + size);
+	if (src)
+		memcpy(w->data->data + offset, src, size);
+	else
+		memset(w->data->data + offset, 0, size);
+
+	return offset;
+}
+
+/* Pointers are stored as the offset of their target. Offset 0 is the
+ * header, so 0 means NULL */
+static void
+image_set_pointer(struct image_writer *w,
+		  gsize field,
+		  gsize target)
+{
+	uintptr_t value = target;
+
+	memcpy(w->data->data + field, &value, sizeof(value));
+}
+
+/* Objects are copied once, even if referenced from several places */
+static gboolean
+image_lookup(struct image_writer *w,
+	     const void *src,
+	     gsize *offset)
+{
+	*offset = GPOINTER_TO_SIZE(g_hash_table_lookup(w->offsets, src));
+	return *offset != 0;
+}
+
+static gsize
+image_add_object(struct image_writer *w,
+		 const void *src,
+		 gsize size)
+{
+	gsize offset = image_append(w, src, size, IMAGE_ALIGN);
+
+	g_hash_table_insert(w->offsets, (gpointer)src, GSIZE_TO_POINTER(offset));
+
+	return offset;
+}
+
+static gsize
+image_add_data(struct image_writer *w,
+	       const void *src,
+	       gsize size)
+{
+	return src ? image_append(w, src, size, IMAGE_ALIGN) : 0;
+}
+
+static gsize
+image_add_array(struct image_writer *w,
+		const void *src,
+		guint count,
+		image_add_func add)
+{
+	const void *const *array = src;
+	gsize offset;
+
+	if (!array)
+		return 0;
+
+	offset = image_append(w, NULL, count * sizeof(gpointer), IMAGE_ALIGN);
+	for (guint i = 0; i < count; i++)
+		image_set_pointer(w, offset + i * sizeof(gpointer), add(w, array[i]));
+
+	return offset;
+}
+
+static gsize
+image_add_string(struct image_writer *w,
+		 const void *src)
+{
+	const char *str = src;
+	gsize offset;
+
+	if (!str)
+		return 0;
+
+	if (!image_lookup(w, str, &offset)) {
+		offset = image_append(w, str, strlen(str) + 1, 1);
+		g_hash_table_insert(w->offsets, (gpointer)str, GSIZE_TO_POINTER(offset));
+	}
+
+	return offset;
+}
+
+static gsize
+image_add_match(struct image_writer *w,
+		const void *src)
+{
+	const WacomMatch *match = src;
+	gsize offset;
+
+	if (!match)
+		return 0;
+	if (image_lookup(w, match, &offset))
+		return offset;
+
+	offset = image_add_object(w, match, sizeof(*match));
+	image_set_pointer(w,
+			  offset + offsetof(WacomMatch, name),
+			  image_add_string(w, match->name));
+	image_set_pointer(w,
+			  offset + offsetof(WacomMatch, uniq),
+			  image_add_string(w, match->uniq));
+	image_set_pointer(w,
+			  offset + offsetof(WacomMatch, match),
+			  image_add_string(w, match->match));
+	/* The match string is already formatted */
+	image_set_pointer(w, offset + offsetof(WacomMatch, arena), 0);
+
+	return offset;
+}
+
+static gsize
+image_add_device(struct image_writer *w,
+		 const void *src);
+
+static gsize
+image_add_stylus_details(struct image_writer *w,
+			 const WacomStylusDetails *details)
+{
+	gsize offset;
+
+	offset = image_add_object(w, details, sizeof(*details));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylusDetails, group),
+			  image_add_string(w, details->group));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylusDetails, paired_stylus_ids),
+			  image_add_data(w,
+					 details->paired_stylus_ids,
+					 details->num_paired_stylus_ids *
+						 sizeof(*details->paired_stylus_ids)));
+	/* Including the NULL terminator */
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylusDetails, devices),
+			  image_add_array(w,
+					  details->devices,
+					  details->num_devices + 1,
+					  image_add_device));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylusDetails, deprecated_paired_ids),
+			  image_add_data(w,
+					 details->deprecated_paired_ids,
+					 details->num_deprecated_paired_ids *
+						 sizeof(int)));
+	/* The deprecated ids are already built */
+	image_set_pointer(w, offset + offsetof(WacomStylusDetails, arena), 0);
+
+	return offset;
+}
+
+static gsize
+image_add_stylus(struct image_writer *w,
+		 const void *src)
+{
+	const WacomStylus *stylus = src;
+	gsize offset;
+
+	if (!stylus)
+		return 0;
+	if (image_lookup(w, stylus, &offset))
+		return offset;
+
+	offset = image_add_object(w, stylus, sizeof(*stylus));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylus, name),
+			  image_add_string(w, stylus->name));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylus, paired_styli),
+			  image_add_array(w,
+					  stylus->paired_styli,
+					  stylus->num_paired_styli,
+					  image_add_stylus));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylus, paired_eraser),
+			  image_add_stylus(w, stylus->paired_eraser));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylus, paired_pen),
+			  image_add_stylus(w, stylus->paired_pen));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStylus, details),
+			  image_add_stylus_details(w, stylus->details));
+
+	return offset;
+}
+
+static gsize
+image_add_styli_set(struct image_writer *w,
+		    const void *src)
+{
+	const WacomStyliSet *set = src;
+	gsize offset;
+
+	if (!set)
+		return 0;
+	if (image_lookup(w, set, &offset))
+		return offset;
+
+	offset = image_add_object(w, set, sizeof(*set));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStyliSet, styli),
+			  image_add_array(w, set->styli, set->num_styli, image_add_stylus));
+	image_set_pointer(w,
+			  offset + offsetof(WacomStyliSet, deprecated_ids),
+			  image_add_data(w,
+					 set->deprecated_ids,
+					 set->num_deprecated_ids * sizeof(int)));
+	image_set_pointer(w, offset + offsetof(WacomStyliSet, arena), 0);
+
+	return offset;
+}
+
+static gsize
+image_add_device_details(struct image_writer *w,
+			 const WacomDeviceDetails *details)
+{
+	gsize offset;
+
+	/* No pointers, it is used in place */
+	return image_add_object(w, details, sizeof(*details));
+}
+
+static gsize
+image_add_device(struct image_writer *w,
+		 const void *src)
+{
+	const WacomDevice *device = src;
+	gsize offset;
+
+	if (!device)
+		return 0;
+	if (image_lookup(w, device, &offset))
+		return offset;
+
+	offset = image_add_object(w, device, sizeof(*device));
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, name),
+			  image_add_string(w, device->name));
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, model_name),
+			  image_add_string(w, device->model_name));
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, layout),
+			  image_add_string(w, device->layout));
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, match),
+			  image_add_match(w, device->match));
+	/* Including the NULL terminator */
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, matches),
+			  image_add_array(w,
+					  device->matches,
+					  device->num_matches + 1,
+					  image_add_match));
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, paired),
+			  image_add_match(w, device->paired));
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, styli),
+			  image_add_styli_set(w, device->styli));
+	image_set_pointer(w,
+			  offset + offsetof(WacomDevice, details),
+			  image_add_device_details(w, device->details));
+
+	return offset;
+}
+
+static gboolean
+image_write(const void *data,
+	    gsize size,
+	    int fd)
+{
+	const char *p = data;
+
+	while (size > 0) {
+		ssize_t written = write(fd, p, size);
+
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		p += written;
+		size -= written;
+	}
+
+	return fcntl(fd,
+		     F_ADD_SEALS,
+		     F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0;
+}
+
+LIBWACOM_EXPORT int
+libwacom_database_export_fd(WacomDeviceDatabase *db,
+			    WacomError *error)
+{
+	struct image_writer w;
+	struct image_header *header;
+	g_autoptr(GPtrArray) keys = g_ptr_array_new();
+	g_autoptr(GPtrArray) values = g_ptr_array_new();
+	GHashTableIter iter;
+	gpointer key, value;
+	gsize table;
+	int fd;
+
+	/* Nothing may be built on first use in a read-only image */
+	libwacom_database_build_lazy(db);
+
+	w.data = g_byte_array_new();
+	w.offsets = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	image_append(&w, NULL, sizeof(*header), IMAGE_ALIGN);
+
+	g_hash_table_iter_init(&iter, db->device_ht);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		g_ptr_array_add(keys, key);
+		g_ptr_array_add(values, value);
+	}
+	table = image_append(&w, NULL, keys->len * sizeof(struct image_entry), IMAGE_ALIGN);
+	for (guint i = 0; i < keys->len; i++) {
+		gsize entry = table + i * sizeof(struct image_entry);
+
+		image_set_pointer(&w,
+				  entry + offsetof(struct image_entry, match),
+				  image_add_match(&w, g_ptr_array_index(keys, i)));
+		image_set_pointer(&w,
+				  entry + offsetof(struct image_entry, device),
+				  image_add_device(&w, g_ptr_array_index(values, i)));
+	}
+	header = (struct image_header *)w.data->data;
+	header->entries.offset = table;
+	header->entries.count = keys->len;
+
+	g_ptr_array_set_size(values, 0);
+	g_hash_table_iter_init(&iter, db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		g_ptr_array_add(values, value);
+	table = image_add_array(&w, values->pdata, values->len, image_add_stylus);
+	header = (struct image_header *)w.data->data;
+	header->styli.offset = table;
+	header->styli.count = values->len;
+
+	g_ptr_array_set_size(values, 0);
+	g_hash_table_iter_init(&iter, db->arena->interned);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+		g_ptr_array_add(values, key);
+	table = image_add_array(&w, values->pdata, values->len, image_add_string);
+	header = (struct image_header *)w.data->data;
+	header->strings.offset = table;
+	header->strings.count = values->len;
+
+	table = image_add_data(&w,
+			       db->uniq_rules->data,
+			       db->uniq_rules->len * sizeof(WacomUniqRule));
+	for (guint i = 0; i < db->uniq_rules->len; i++) {
+		WacomUniqRule *rule = &g_array_index(db->uniq_rules, WacomUniqRule, i);
+
+		image_set_pointer(&w,
+				  table + i * sizeof(*rule) +
+					  offsetof(WacomUniqRule, prefix),
+				  image_add_string(&w, rule->prefix));
+	}
+	header = (struct image_header *)w.data->data;
+	header->uniq_rules.offset = table;
+	header->uniq_rules.count = db->uniq_rules->len;
+
+	header = (struct image_header *)w.data->data;
+	memcpy(header->magic, IMAGE_MAGIC, sizeof(header->magic));
+	header->version = IMAGE_VERSION;
+	header->header_size = sizeof(*header);
+	header->pointer_size = sizeof(gpointer);
+	header->device_size = sizeof(WacomDevice);
+	header->device_details_size = sizeof(WacomDeviceDetails);
+	header->match_size = sizeof(WacomMatch);
+	header->stylus_size = sizeof(WacomStylus);
+	header->stylus_details_size = sizeof(WacomStylusDetails);
+	header->styli_set_size = sizeof(WacomStyliSet);
+	header->uniq_rule_size = sizeof(WacomUniqRule);
+	header->size = w.data->len;
+
+	fd = memfd_create("libwacom-database", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd >= 0 && !image_write(w.data->data, w.data->len, fd)) {
+		close(fd);
+		fd = -1;
+	}
+	if (fd < 0)
+		libwacom_error_set(error,
+				   WERROR_BAD_ALLOC,
+				   "Failed to write the database image: %s",
+				   g_strerror(errno));
+
+	g_byte_array_unref(w.data);
+	g_hash_table_destroy(w.offsets);
+
+	return fd;
+}
+
+struct image_reader {
+	const char *start;
+	gsize size;
+	WacomArena *arena; /* for the copies */
+	/* offset -> copy. All styli and devices are copied first so they
+	 * can point at each other, matches and styli sets when first used */
+	GHashTable *styli;
+	GHashTable *devices;
+	GHashTable *matches;
+	GHashTable *styli_sets;
+};
+
+/* Returns NULL unless the object at offset is inside the image */
+static const void *
+image_get(const struct image_reader *r,
+	  uintptr_t offset,
+	  gsize size,
+	  gsize align)
+{
+	if (offset == 0 || offset > r->size || size > r->size - offset ||
+	    offset % align != 0)
+		return NULL;
+
+	return r->start + offset;
+}
+
+/* The functions below resolve the offset stored in a pointer field of a
+ * copy to a pointer into the image or to another copy */
+
+static gboolean
+image_resolve_data(const struct image_reader *r,
+		   const void **data,
+		   gsize count,
+		   gsize size,
+		   gsize align)
+{
+	uintptr_t offset = (uintptr_t)*data;
+
+	if (offset == 0)
+		return count == 0;
+	if (count > r->size / size)
+		return FALSE;
+
+	*data = image_get(r, offset, count * size, align);
+
+	return *data != NULL;
+}
+
+static gboolean
+image_resolve_string(const struct image_reader *r,
+		     const char **str,
+		     gboolean nullable)
+{
+	uintptr_t offset = (uintptr_t)*str;
+
+	if (offset == 0)
+		return nullable;
+
+	*str = image_get(r, offset, 1, 1);
+
+	return *str && memchr(*str, '\0', r->size - offset) != NULL;
+}
+
+/* An array of styli or devices, optionally NULL-terminated */
+static gboolean
+image_resolve_array(const struct image_reader *r,
+		    GHashTable *copies,
+		    gpointer **array,
+		    gsize count,
+		    gboolean terminated)
+{
+	const uintptr_t *offsets = (const uintptr_t *)*array;
+	gpointer *copy;
+
+	if (!offsets)
+		return count == 0;
+	if (!image_resolve_data(r,
+				(const void **)&offsets,
+				count + terminated,
+				sizeof(*offsets),
+				alignof(uintptr_t)))
+		return FALSE;
+
+	copy = arena_alloc(&r->arena->objects, (count + terminated) * sizeof(*copy));
+	for (gsize i = 0; i < count; i++) {
+		copy[i] = g_hash_table_lookup(copies, GSIZE_TO_POINTER(offsets[i]));
+		if (!copy[i])
+			return FALSE;
+	}
+	if (terminated) {
+		if (offsets[count] != 0)
+			return FALSE;
+		copy[count] = NULL;
+	}
+	*array = copy;
+
+	return TRUE;
+}
+
+static gboolean
+image_resolve_match(struct image_reader *r,
+		    WacomMatch **match,
+		    gboolean nullable)
+{
+	uintptr_t offset = (uintptr_t)*match;
+	const WacomMatch *src;
+	WacomMatch *copy;
+
+	if (offset == 0)
+		return nullable;
+
+	copy = g_hash_table_lookup(r->matches, GSIZE_TO_POINTER(offset));
+	if (!copy) {
+		src = image_get(r, offset, sizeof(*src), alignof(WacomMatch));
+		/* The match string is already formatted */
+		if (!src || src->arena)
+			return FALSE;
+
+		copy = arena_memdup(&r->arena->objects, src, sizeof(*src));
+		if (!image_resolve_string(r, &copy->name, TRUE) ||
+		    !image_resolve_string(r, &copy->uniq, TRUE) ||
+		    !image_resolve_string(r, (const char **)&copy->match, FALSE))
+			return FALSE;
+		g_hash_table_insert(r->matches, GSIZE_TO_POINTER(offset), copy);
+	}
+	*match = copy;
+
+	return TRUE;
+}
+
+static gboolean
+image_resolve_styli_set(struct image_reader *r,
+			const WacomStyliSet **set)
+{
+	uintptr_t offset = (uintptr_t)*set;
+	const WacomStyliSet *src;
+	WacomStyliSet *copy;
+
+	copy = g_hash_table_lookup(r->styli_sets, GSIZE_TO_POINTER(offset));
+	if (!copy) {
+		src = image_get(r, offset, sizeof(*src), alignof(WacomStyliSet));
+		/* The deprecated ids are already built */
+		if (!src || src->summary.num_styli != (int)src->num_styli ||
+		    src->deprecated_ids_once == 0 || src->arena)
+			return FALSE;
+
+		copy = arena_memdup(&r->arena->objects, src, sizeof(*src));
+		if (!image_resolve_array(r,
+					 r->styli,
+					 (gpointer **)&copy->styli,
+					 copy->num_styli,
+					 FALSE) ||
+		    !image_resolve_data(r,
+					(const void **)&copy->deprecated_ids,
+					copy->num_deprecated_ids,
+					sizeof(int),
+					alignof(int)))
+			return FALSE;
+		g_hash_table_insert(r->styli_sets, GSIZE_TO_POINTER(offset), copy);
+	}
+	*set = copy;
+
+	return TRUE;
+}
+
+static gboolean
+image_resolve_stylus(struct image_reader *r,
+		     WacomStylus *stylus)
+{
+	const WacomStylusDetails *src;
+	WacomStylusDetails *details;
+
+	if (stylus->index >= g_hash_table_size(r->styli) ||
+	    !image_resolve_string(r, &stylus->name, FALSE) ||
+	    !image_resolve_array(r,
+				 r->styli,
+				 (gpointer **)&stylus->paired_styli,
+				 stylus->num_paired_styli,
+				 FALSE))
+		return FALSE;
+
+	if (stylus->paired_eraser) {
+		stylus->paired_eraser = g_hash_table_lookup(r->styli, stylus->paired_eraser);
+		if (!stylus->paired_eraser)
+			return FALSE;
+	}
+	if (stylus->paired_pen) {
+		stylus->paired_pen = g_hash_table_lookup(r->styli, stylus->paired_pen);
+		if (!stylus->paired_pen)
+			return FALSE;
+	}
+
+	src = image_get(r,
+			(uintptr_t)stylus->details,
+			sizeof(*src),
+			alignof(WacomStylusDetails));
+	/* The deprecated ids are already built */
+	if (!src || src->deprecated_paired_ids_once == 0 || src->arena)
+		return FALSE;
+
+	details = arena_memdup(&r->arena->details, src, sizeof(*src));
+	stylus->details = details;
+
+	return image_resolve_string(r, &details->group, TRUE) &&
+	       image_resolve_data(r,
+				  (const void **)&details->paired_stylus_ids,
+				  details->num_paired_stylus_ids,
+				  sizeof(WacomStylusId),
+				  alignof(WacomStylusId)) &&
+	       image_resolve_array(r,
+				   r->devices,
+				   (gpointer **)&details->devices,
+				   details->num_devices,
+				   TRUE) &&
+	       image_resolve_data(r,
+				  (const void **)&details->deprecated_paired_ids,
+				  details->num_deprecated_paired_ids,
+				  sizeof(int),
+				  alignof(int));
+}
+
+/* The lookup tables only ever point back at the buttons, keys and LEDs,
+ * and the key table needs an empty slot for the lookup to terminate */
+static gboolean
+image_lookup_tables_valid(const WacomDeviceDetails *details)
+{
+	gboolean has_empty_slot = FALSE;
+
+	for (guint i = 0; i < WACOM_NUM_BUTTON_CODES; i++) {
+		char button = details->button_for_code[i];
+
+		if (button != 0 &&
+		    (button < 'A' || button > 'Z' ||
+		     details->buttons[button - 'A'].code != (int)(i + WACOM_BUTTON_CODE_MIN)))
+			return FALSE;
+	}
+
+	for (guint i = 0; i < WACOM_MAX_BUTTONS; i++) {
+		if (details->button_led_groups[i] < -1 ||
+		    details->button_led_groups[i] >= (int)details->num_status_leds)
+			return FALSE;
+	}
+
+	for (guint i = 0; i < WACOM_KEYCODE_SLOTS; i++) {
+		if (details->key_for_code[i] == 0)
+			has_empty_slot = TRUE;
+		else if (details->key_for_code[i] > details->num_keycodes)
+			return FALSE;
+	}
+
+	return has_empty_slot;
+}
+
+static gboolean
+image_resolve_device(struct image_reader *r,
+		     WacomDevice *device)
+{
+	const WacomDeviceDetails *details;
+	const uintptr_t *offsets = (const uintptr_t *)device->matches;
+	WacomMatch **matches;
+
+	if (device->num_buttons > WACOM_MAX_BUTTONS || device->name_override ||
+	    device->arena)
+		return FALSE;
+
+	/* Shared in place */
+	details = image_get(r,
+			    (uintptr_t)device->details,
+			    sizeof(*details),
+			    alignof(WacomDeviceDetails));
+	if (!details || details->num_status_leds > G_N_ELEMENTS(details->status_leds) ||
+	    details->num_keycodes > G_N_ELEMENTS(details->keycodes) ||
+	    !image_lookup_tables_valid(details))
+		return FALSE;
+	device->details = (WacomDeviceDetails *)details;
+
+	if (!image_resolve_string(r, &device->name, FALSE) ||
+	    !image_resolve_string(r, &device->model_name, TRUE) ||
+	    !image_resolve_string(r, &device->layout, TRUE) ||
+	    !image_resolve_match(r, &device->match, FALSE) ||
+	    !image_resolve_match(r, &device->paired, TRUE) ||
+	    !image_resolve_styli_set(r, &device->styli))
+		return FALSE;
+
+	/* Including the NULL terminator */
+	if (!image_resolve_data(r,
+				(const void **)&offsets,
+				device->num_matches + 1ULL,
+				sizeof(*offsets),
+				alignof(uintptr_t)) ||
+	    offsets[device->num_matches] != 0)
+		return FALSE;
+
+	matches = arena_alloc(&r->arena->objects,
+			      (device->num_matches + 1) * sizeof(*matches));
+	for (guint i = 0; i < device->num_matches; i++) {
+		matches[i] = (WacomMatch *)offsets[i];
+		if (!image_resolve_match(r, &matches[i], FALSE))
+			return FALSE;
+	}
+	matches[device->num_matches] = NULL;
+	device->matches = matches;
+
+	return TRUE;
+}
+
+/* Copies the object at offset unless it already was */
+static gboolean
+image_copy_object(struct image_reader *r,
+		  GHashTable *copies,
+		  uintptr_t offset,
+		  gsize size,
+		  gsize align)
+{
+	const void *src = image_get(r, offset, size, align);
+
+	if (!src)
+		return FALSE;
+
+	if (!g_hash_table_contains(copies, GSIZE_TO_POINTER(offset)))
+		g_hash_table_insert(copies,
+				    GSIZE_TO_POINTER(offset),
+				    arena_memdup(&r->arena->objects, src, size));
+
+	return TRUE;
+}
+
+static gboolean
+image_table_valid(const struct image_header *header,
+		  const struct image_table *table,
+		  gsize size,
+		  gsize align)
+{
+	return table->offset % align == 0 && table->offset <= header->size &&
+	       table->count <= (header->size - table->offset) / size;
+}
+
+static gboolean
+image_header_valid(const struct image_header *header,
+		   off_t file_size)
+{
+	return memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) == 0 &&
+	       header->version == IMAGE_VERSION &&
+	       header->header_size == sizeof(*header) &&
+	       header->pointer_size == sizeof(gpointer) &&
+	       header->device_size == sizeof(WacomDevice) &&
+	       header->device_details_size == sizeof(WacomDeviceDetails) &&
+	       header->match_size == sizeof(WacomMatch) &&
+	       header->stylus_size == sizeof(WacomStylus) &&
+	       header->stylus_details_size == sizeof(WacomStylusDetails) &&
+	       header->styli_set_size == sizeof(WacomStyliSet) &&
+	       header->uniq_rule_size == sizeof(WacomUniqRule) &&
+	       header->size == (uint64_t)file_size && header->size >= sizeof(*header) &&
+	       header->size <= G_MAXSIZE &&
+	       image_table_valid(header,
+				 &header->entries,
+				 sizeof(struct image_entry),
+				 alignof(struct image_entry)) &&
+	       image_table_valid(header,
+				 &header->styli,
+				 sizeof(uintptr_t),
+				 alignof(uintptr_t)) &&
+	       image_table_valid(header,
+				 &header->strings,
+				 sizeof(uintptr_t),
+				 alignof(uintptr_t)) &&
+	       image_table_valid(header,
+				 &header->uniq_rules,
+				 sizeof(WacomUniqRule),
+				 alignof(WacomUniqRule));
+}
+
+static gboolean
+image_load(WacomDeviceDatabase *db,
+	   const char *addr,
+	   const struct image_header *header)
+{
+	g_autoptr(GHashTable) styli = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_autoptr(GHashTable) devices = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_autoptr(GHashTable) matches = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_autoptr(GHashTable) styli_sets =
+		g_hash_table_new(g_direct_hash, g_direct_equal);
+	struct image_reader r = {
+		.start = addr,
+		.size = header->size,
+		.arena = db->arena,
+		.styli = styli,
+		.devices = devices,
+		.matches = matches,
+		.styli_sets = styli_sets,
+	};
+	const struct image_entry *entries =
+		(const struct image_entry *)(addr + header->entries.offset);
+	const uintptr_t *styli_table = (const uintptr_t *)(addr + header->styli.offset);
+	const uintptr_t *strings = (const uintptr_t *)(addr + header->strings.offset);
+	const WacomUniqRule *rules =
+		(const WacomUniqRule *)(addr + header->uniq_rules.offset);
+	GHashTableIter iter;
+	gpointer value;
+
+	for (uint64_t i = 0; i < header->styli.count; i++) {
+		if (!image_copy_object(&r,
+				       r.styli,
+				       styli_table[i],
+				       sizeof(WacomStylus),
+				       alignof(WacomStylus)))
+			return FALSE;
+	}
+
+	for (uint64_t i = 0; i < header->entries.count; i++) {
+		if (!image_copy_object(&r,
+				       r.devices,
+				       entries[i].device,
+				       sizeof(WacomDevice),
+				       alignof(WacomDevice)))
+			return FALSE;
+	}
+
+	g_hash_table_iter_init(&iter, r.styli);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		if (!image_resolve_stylus(&r, value))
+			return FALSE;
+	}
+
+	g_hash_table_iter_init(&iter, r.devices);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		if (!image_resolve_device(&r, value))
+			return FALSE;
+	}
+
+	for (uint64_t i = 0; i < header->entries.count; i++) {
+		WacomMatch *match = (WacomMatch *)entries[i].match;
+
+		if (!image_resolve_match(&r, &match, FALSE))
+			return FALSE;
+		g_hash_table_insert(db->device_ht,
+				    match,
+				    g_hash_table_lookup(r.devices,
+							GSIZE_TO_POINTER(entries[i].device)));
+	}
+
+	for (uint64_t i = 0; i < header->styli.count; i++) {
+		WacomStylus *stylus =
+			g_hash_table_lookup(r.styli, GSIZE_TO_POINTER(styli_table[i]));
+
+		g_hash_table_replace(db->stylus_ht, &stylus->id, stylus);
+	}
+	libwacom_database_build_stylus_table(db);
+
+	for (uint64_t i = 0; i < header->strings.count; i++) {
+		const char *str = (const char *)strings[i];
+
+		if (!image_resolve_string(&r, &str, FALSE))
+			return FALSE;
+		g_hash_table_add(db->arena->interned, (gpointer)str);
+	}
+
+	for (uint64_t i = 0; i < header->uniq_rules.count; i++) {
+		WacomUniqRule rule = rules[i];
+		const char *prefix = rule.prefix;
+
+		if (!image_resolve_string(&r, &prefix, TRUE))
+			return FALSE;
+		rule.prefix = g_strdup(prefix);
+		g_array_append_val(db->uniq_rules, rule);
+	}
+
+	return TRUE;
+}
+
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_new_from_fd(int fd,
+			      WacomError *error)
+{
+	const int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+	struct image_header header;
+	WacomDeviceDatabase *db;
+	struct stat st;
+	int current_seals;
+	char *addr;
+
+	if (fstat(fd, &st) < 0) {
+		libwacom_error_set(error,
+				   WERROR_BAD_ACCESS,
+				   "Failed to access the database image: %s",
+				   g_strerror(errno));
+		return NULL;
+	}
+
+	/* The pages are shared with whoever else maps the image */
+	current_seals = fcntl(fd, F_GET_SEALS);
+	if (current_seals < 0 || (current_seals & seals) != seals) {
+		libwacom_error_set(error,
+				   WERROR_INVALID_DB,
+				   "The database image is not sealed");
+		return NULL;
+	}
+
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+	    !image_header_valid(&header, st.st_size)) {
+		libwacom_error_set(error,
+				   WERROR_INVALID_DB,
+				   "Invalid or incompatible database image");
+		return NULL;
+	}
+
+	addr = mmap(NULL, header.size, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		libwacom_error_set(error,
+				   WERROR_BAD_ALLOC,
+				   "Failed to map the database image: %s",
+				   g_strerror(errno));
+		return NULL;
+	}
+
+	db = libwacom_database_alloc();
+	/* Unmapped with the arena */
+	db->arena->image = addr;
+	db->arena->image_size = header.size;
+
+	if (!image_load(db, addr, &header)) {
+		libwacom_database_destroy(db);
+		libwacom_error_set(error, WERROR_INVALID_DB, "Invalid database image");
+		return NULL;
+	}
+
+	/* Everything is built already, the copies become read-only like
+	 * the image itself */
+	libwacom_database_freeze(db);
+
+	return db;
+}
+
+#else /* HAVE_MEMFD_CREATE */
+
+LIBWACOM_EXPORT int
+libwacom_database_export_fd(WacomDeviceDatabase *db,
+			    WacomError *error)
+{
+	libwacom_error_set(error,
+			   WERROR_BUG_CALLER,
+			   "Database images are not supported on this system");
+	return -1;
+}
+
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_new_from_fd(int fd,
+			      WacomError *error)
+{
+	libwacom_error_set(error,
+			   WERROR_BUG_CALLER,
+			   "Database images are not supported on this system");
+	return NULL;
+}
+
+#endif /* HAVE_MEMFD_CREATE */
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
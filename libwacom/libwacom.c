@@ -32,6 +32,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 
 #include "libwacom.h"
 #include "libwacomint.h"
@@ -40,71 +42,313 @@
 #define g_memdup2 g_memdup
 #endif
 
+static inline bool
+match_is_generic(const WacomMatch *match)
+{
+	return match->name == NULL && match->bus == WBUSTYPE_UNKNOWN &&
+	       match->vendor_id == 0 && match->product_id == 0;
+}
+
+/* Fills in a match to look up in the device hashtable. Returns false
+ * if no match in the database can have these fields */
+static bool
+match_key_init(const WacomDeviceDatabase *db,
+	       WacomMatch *key,
+	       const char *name,
+	       const char *uniq,
+	       WacomBusType bus,
+	       int vendor_id,
+	       int product_id)
+{
+	if (vendor_id < 0 || vendor_id > 0xffff || product_id < 0 ||
+	    product_id > 0xffff)
+		return false;
+
+	*key = (WacomMatch){
+		.name = libwacom_arena_lookup(db->arena, name),
+		.uniq = libwacom_arena_lookup(db->arena, uniq),
+		.vendor_id = vendor_id,
+		.product_id = product_id,
+		.bus = bus,
+	};
+
+	return (name == NULL || key->name) && (uniq == NULL || key->uniq);
+}
+
 static const WacomDevice *
 libwacom_get_device(const WacomDeviceDatabase *db,
-		    const char *match)
+		    const WacomMatch *key,
+		    const WacomMatch **match)
+{
+	gpointer orig_key, device;
+
+	if (!g_hash_table_lookup_extended(db->device_ht, key, &orig_key, &device))
+		return NULL;
+
+	if (match)
+		*match = orig_key;
+
+	return device;
+}
+
+static GUdevDevice *
+client_query_by_subsystem_and_device_file(GUdevClient *client,
+					  const char *subsystem,
+					  const char *path)
+{
+	GList *l;
+	g_autoptr(GList) devices;
+	GUdevDevice *ret = NULL;
+
+	devices = g_udev_client_query_by_subsystem(client, subsystem);
+	for (l = devices; l != NULL; l = l->next) {
+		if (!ret &&
+		    g_strcmp0(g_udev_device_get_device_file(l->data), path) == 0)
+			ret = g_object_ref(l->data);
+		g_object_unref(l->data);
+	}
+	return ret;
+}
+
+static void *
+gudev_lookup(const WacomUdevBackend *backend,
+	     const char *devnode)
+{
+	g_autoptr(GUdevClient) client = NULL;
+	const char *const subsystems[] = { "input", NULL };
+	GUdevDevice *device;
+
+	client = g_udev_client_new(subsystems);
+	device = client_query_by_subsystem_and_device_file(client, subsystems[0], devnode);
+	if (device == NULL)
+		device = g_udev_client_query_by_device_file(client, devnode);
+
+	return device;
+}
+
+static void *
+gudev_get_parent(void *node)
+{
+	return g_udev_device_get_parent(node);
+}
+
+static const char *
+gudev_get_property(void *node,
+		   const char *key)
+{
+	return g_udev_device_get_property(node, key);
+}
+
+static const char *
+gudev_get_subsystem(void *node)
+{
+	return g_udev_device_get_subsystem(node);
+}
+
+static const char *
+gudev_get_sysname(void *node)
+{
+	return g_udev_device_get_name(node);
+}
+
+static void
+gudev_unref(void *node)
+{
+	g_object_unref(node);
+}
+
+const WacomUdevBackend udev_backend_gudev = {
+	.lookup = gudev_lookup,
+	.get_parent = gudev_get_parent,
+	.get_property = gudev_get_property,
+	.get_subsystem = gudev_get_subsystem,
+	.get_sysname = gudev_get_sysname,
+	.unref = gudev_unref,
+	.sysfs_root = "/sys",
+};
+
+/* Same semantics as g_udev_device_get_property_as_boolean() */
+static gboolean
+get_property_as_boolean(const WacomUdevBackend *backend,
+			void *node,
+			const char *key)
 {
-	return (WacomDevice *)g_hash_table_lookup(db->device_ht, match);
+	const char *value = backend->get_property(node, key);
+
+	return value && (g_str_equal(value, "1") || g_ascii_strcasecmp(value, "true") == 0);
 }
 
 static gboolean
-is_tablet(GUdevDevice *device)
+is_tablet(const WacomUdevBackend *backend,
+	  void *node)
 {
-	return g_udev_device_get_property_as_boolean(device, "ID_INPUT_TABLET");
+	return get_property_as_boolean(backend, node, "ID_INPUT_TABLET");
 }
 
 static gboolean
-is_touchpad(GUdevDevice *device)
+is_touchpad(const WacomUdevBackend *backend,
+	    void *node)
 {
-	return g_udev_device_get_property_as_boolean(device, "ID_INPUT_TOUCHPAD");
+	return get_property_as_boolean(backend, node, "ID_INPUT_TOUCHPAD");
 }
 
 static gboolean
-is_tablet_or_touchpad(GUdevDevice *device)
+is_tablet_or_touchpad(const WacomUdevBackend *backend,
+		      void *node)
 {
-	return is_touchpad(device) || is_tablet(device);
+	return is_touchpad(backend, node) || is_tablet(backend, node);
 }
 
-/* Overriding SUBSYSTEM isn't allowed in udev (works sometimes, but not
- * always). For evemu devices we need to set custom properties to make them
- * detected by libwacom.
- */
+/* NAME and UNIQ properties are enclosed with quotes */
 static char *
-get_uinput_subsystem(GUdevDevice *device)
+strdup_unquoted(const char *v)
 {
-	const char *bus_str;
-	GUdevDevice *parent;
+	size_t offset = v[0] == '"' ? 1 : 0;
+	char *value = g_strdup(v + offset);
+	size_t len = strlen(value);
+
+	if (len > 0 && value[len - 1] == '"')
+		value[len - 1] = '\0';
+
+	return value;
+}
+
+static WacomIntegrationFlags
+get_integration_flags(const WacomUdevBackend *backend,
+		      const char *sysname)
+{
+	g_autofree char *sysfs_path = NULL;
+	g_autofree char *contents = NULL;
+	int flag;
+
+	if (sysname == NULL)
+		return WACOM_DEVICE_INTEGRATED_UNSET; // NOLINT: core.EnumCastOutOfRange
+
+	sysfs_path = g_build_filename(backend->sysfs_root,
+				      "class/input",
+				      sysname,
+				      "device/properties",
+				      NULL);
+	if (!g_file_get_contents(sysfs_path, &contents, NULL, NULL))
+		return WACOM_DEVICE_INTEGRATED_UNSET; // NOLINT: core.EnumCastOutOfRange
+
+	flag = atoi(contents);
+	flag &= (1 << INPUT_PROP_DIRECT) | (1 << INPUT_PROP_POINTER);
+	/*
+	 * To ensure we are dealing with a screen tablet, need
+	 * to check that it has DIRECT and non-POINTER (DIRECT
+	 * alone is not sufficient since it's set for drawing
+	 * tablets as well)
+	 */
+	if (flag == (1 << INPUT_PROP_DIRECT))
+		return WACOM_DEVICE_INTEGRATED_DISPLAY;
+
+	return WACOM_DEVICE_INTEGRATED_NONE;
+}
 
-	bus_str = NULL;
-	parent = g_object_ref(device);
+/* Look up the device node in udev and collect everything we need from the
+ * node and its ancestors in a single walk up the parent chain. Each
+ * property is taken from the closest device that has it set.
+ */
+WacomDeviceInfo *
+device_info_new_from_path(const WacomUdevBackend *backend,
+			  const char *path,
+			  WacomError *error)
+{
+	void *node;
+	WacomDeviceInfo *info;
+	gboolean have_subsystem = FALSE;
 
-	while (parent &&
-	       !g_udev_device_get_property_as_boolean(parent, "UINPUT_DEVICE")) {
-		GUdevDevice *old_parent = parent;
-		parent = g_udev_device_get_parent(old_parent);
-		g_object_unref(old_parent);
+	node = backend->lookup(backend, path);
+	if (node == NULL) {
+		libwacom_error_set(error,
+				   WERROR_INVALID_PATH,
+				   "Could not find device '%s' in udev",
+				   path);
+		return NULL;
 	}
 
-	if (parent) {
-		bus_str = g_udev_device_get_property(parent, "UINPUT_SUBSYSTEM");
-		g_object_unref(parent);
+	info = g_new0(WacomDeviceInfo, 1);
+	info->devnode = g_strdup(path);
+	info->sysname = g_strdup(backend->get_sysname(node));
+	/* Touchpads are only for the "Finger" part of Bamboo devices */
+	info->is_touchpad = is_touchpad(backend, node);
+
+	for (int depth = 0; node; depth++) {
+		void *parent;
+		const char *value;
+
+		/* ID_INPUT_TABLET may be on the event node or its parent */
+		if (depth < 2 && is_tablet_or_touchpad(backend, node))
+			info->is_tablet_or_touchpad = TRUE;
+
+		if (!info->name && (value = backend->get_property(node, "NAME")))
+			info->name = strdup_unquoted(value);
+
+		if (!info->uniq && (value = backend->get_property(node, "UNIQ")))
+			info->uniq = strdup_unquoted(value);
+
+		/* E: PRODUCT=5/56a/81/100 */
+		if (!info->product && (value = backend->get_property(node, "PRODUCT")))
+			info->product = g_strdup(value);
+
+		/* Overriding SUBSYSTEM isn't allowed in udev (works sometimes,
+		 * but not always). For evemu devices we need to set custom
+		 * properties to make them detected by libwacom.
+		 */
+		if (!info->is_uinput &&
+		    get_property_as_boolean(backend, node, "UINPUT_DEVICE")) {
+			info->is_uinput = TRUE;
+			info->uinput_subsystem = g_strdup(
+				backend->get_property(node, "UINPUT_SUBSYSTEM"));
+		}
+
+		/* The bus is the first subsystem that isn't input or hid */
+		if (!have_subsystem) {
+			value = backend->get_subsystem(node);
+			if (!value ||
+			    (!g_str_equal(value, "input") && !g_str_equal(value, "hid"))) {
+				info->subsystem = g_strdup(value);
+				have_subsystem = TRUE;
+			}
+		}
+
+		parent = backend->get_parent(node);
+		backend->unref(node);
+		node = parent;
 	}
 
-	return bus_str ? g_strdup(bus_str) : NULL;
+	/* Is the device integrated in display? */
+	info->integration_flags = get_integration_flags(backend, info->sysname);
+
+	return info;
+}
+
+void
+device_info_free(WacomDeviceInfo *info)
+{
+	if (!info)
+		return;
+
+	g_free(info->devnode);
+	g_free(info->sysname);
+	g_free(info->name);
+	g_free(info->uniq);
+	g_free(info->product);
+	g_free(info->subsystem);
+	g_free(info->uinput_subsystem);
+	g_free(info);
 }
 
 static gboolean
-get_bus_vid_pid(GUdevDevice *device,
-		WacomBusType *bus,
-		int *vendor_id,
-		int *product_id,
-		WacomError *error)
+parse_product(const char *product_str,
+	      WacomBusType *bus,
+	      int *vendor_id,
+	      int *product_id,
+	      WacomError *error)
 {
-	g_autoptr(GUdevDevice) parent = NULL;
-	const char *product_str;
 	g_auto(GStrv) splitted_product = NULL;
 	unsigned int bus_id;
-	gboolean retval = FALSE;
 	guint64 val;
 
 	/* Parse that:
@@ -112,355 +356,208 @@ get_bus_vid_pid(GUdevDevice *device,
 	 * into:
 	 * vendor 0x56a
 	 * product 0x81 */
-	parent = g_object_ref(device);
-	product_str = g_udev_device_get_property(device, "PRODUCT");
-
-	while (!product_str && parent) {
-		GUdevDevice *old_parent = parent;
-		parent = g_udev_device_get_parent(old_parent);
-		if (parent)
-			product_str = g_udev_device_get_property(parent, "PRODUCT");
-		g_object_unref(old_parent);
-	}
-
 	if (!product_str)
 		/* PRODUCT not found, hoping the old method will work */
-		goto out;
+		return FALSE;
 
 	splitted_product = g_strsplit(product_str, "/", 4);
 	if (g_strv_length(splitted_product) != 4) {
 		libwacom_error_set(error,
 				   WERROR_UNKNOWN_MODEL,
 				   "Unable to parse model identification");
-		goto out;
+		return FALSE;
 	}
 
 	if (!g_ascii_string_to_unsigned(splitted_product[0], 16, 0, 0xff, &val, NULL))
-		goto out;
+		return FALSE;
 
 	bus_id = val;
 	if (!g_ascii_string_to_unsigned(splitted_product[1], 16, 0, 0xffff, &val, NULL))
-		goto out;
+		return FALSE;
 
 	*vendor_id = (int)val;
 	if (!g_ascii_string_to_unsigned(splitted_product[2], 16, 0, 0xffff, &val, NULL))
-		goto out;
+		return FALSE;
 
 	*product_id = (int)val;
 
 	switch (bus_id) {
 	case 0:
 		*bus = WBUSTYPE_UNKNOWN;
-		retval = TRUE;
-		break;
+		return TRUE;
 	case 3:
 		*bus = WBUSTYPE_USB;
-		retval = TRUE;
-		break;
+		return TRUE;
 	case 5:
 		*bus = WBUSTYPE_BLUETOOTH;
-		retval = TRUE;
-		break;
+		return TRUE;
 	case 24:
 		*bus = WBUSTYPE_I2C;
-		retval = TRUE;
-		break;
+		return TRUE;
 	}
 
-out:
-	return retval;
+	return FALSE;
 }
 
-static char *
-get_bus(GUdevDevice *device)
+static const char *
+device_info_get_bus_str(const WacomDeviceInfo *info)
 {
-	const char *subsystem;
-	char *bus_str;
-	GUdevDevice *parent;
-
-	bus_str = get_uinput_subsystem(device);
-	if (bus_str)
-		return bus_str;
-
-	subsystem = g_udev_device_get_subsystem(device);
-	parent = g_object_ref(device);
+	if (info->uinput_subsystem)
+		return info->uinput_subsystem;
 
-	while (parent && subsystem &&
-	       (g_str_equal(subsystem, "input") || g_str_equal(subsystem, "hid"))) {
-		GUdevDevice *old_parent = parent;
-		parent = g_udev_device_get_parent(old_parent);
-		if (parent)
-			subsystem = g_udev_device_get_subsystem(parent);
-		g_object_unref(old_parent);
-	}
-
-	if (parent) {
-		if (subsystem &&
-		    (g_str_equal(subsystem, "tty") || g_str_equal(subsystem, "serio")))
-			bus_str = g_strdup("serial");
-		else
-			bus_str = g_strdup(subsystem);
+	if (!info->subsystem)
+		return "unknown";
 
-		g_object_unref(parent);
-	} else
-		bus_str = strdup("unknown");
+	if (g_str_equal(info->subsystem, "tty") || g_str_equal(info->subsystem, "serio"))
+		return "serial";
 
-	return bus_str;
+	return info->subsystem;
 }
 
-static GUdevDevice *
-client_query_by_subsystem_and_device_file(GUdevClient *client,
-					  const char *subsystem,
-					  const char *path)
+/* The UCLogic kernel driver returns firmware names with form
+ * <vendor>_<model>_<version>. Used if the datadirs have no .uniq files. */
+static const WacomUniqRule uniq_rule_uclogic = {
+	.prefix = NULL,
+	.separator = '_',
+	.min_fields = 3,
+	.strip_fields = 1,
+};
+
+static char *
+uniq_rule_apply(const WacomUniqRule *rule,
+		const char *uniq)
 {
-	GList *l;
-	g_autoptr(GList) devices;
-	GUdevDevice *ret = NULL;
+	const char *cut = NULL;
+	guint nfields = 1;
+	guint stripped = 0;
 
-	devices = g_udev_client_query_by_subsystem(client, subsystem);
-	for (l = devices; l != NULL; l = l->next) {
-		if (!ret &&
-		    g_strcmp0(g_udev_device_get_device_file(l->data), path) == 0)
-			ret = g_object_ref(l->data);
-		g_object_unref(l->data);
+	if (rule->prefix && !g_str_has_prefix(uniq, rule->prefix))
+		return NULL;
+
+	for (const char *c = uniq; *c; c++) {
+		if (*c == rule->separator)
+			nfields++;
 	}
-	return ret;
-}
 
-static char *
-get_device_prop(GUdevDevice *device,
-		const char *propname)
-{
-	char *value = NULL;
-	g_autoptr(GUdevDevice) parent = g_object_ref(device);
-
-	do {
-		GUdevDevice *next;
-		const char *v = g_udev_device_get_property(parent, propname);
-		if (v) {
-			size_t len;
-			/* NAME and UNIQ properties are enclosed with quotes */
-			size_t offset = v[0] == '"' ? 1 : 0;
-			value = g_strdup(v + offset);
-			len = strlen(value);
-			if (len > 0 && value[len - 1] == '"')
-				value[len - 1] = '\0';
-			break;
-		}
-		next = g_udev_device_get_parent(parent);
-		g_object_unref(parent);
-		parent = next;
-	} while (parent);
+	if (nfields < rule->min_fields || nfields <= rule->strip_fields)
+		return NULL;
 
-	return value;
+	for (cut = uniq + strlen(uniq); stripped < rule->strip_fields; cut--) {
+		if (cut[-1] == rule->separator)
+			stripped++;
+	}
+
+	return g_strndup(uniq, cut - uniq);
 }
 
+/* Remove the firmware version from `uniq` to avoid mismatches on
+ * firmware updates */
 static char *
-parse_uniq(char *uniq)
+parse_uniq(const WacomDeviceDatabase *db,
+	   const char *uniq)
 {
-	g_autoptr(GRegex) regex = NULL;
-	g_autoptr(GMatchInfo) match_info = NULL;
+	const WacomUniqRule *rules = &uniq_rule_uclogic;
+	guint nrules = 1;
 
-	if (!uniq)
+	if (!uniq || strlen(uniq) == 0)
 		return NULL;
 
-	if (strlen(uniq) == 0) {
-		g_free(uniq);
-		return NULL;
+	if (db && db->uniq_rules && db->uniq_rules->len > 0) {
+		rules = &g_array_index(db->uniq_rules, WacomUniqRule, 0);
+		nrules = db->uniq_rules->len;
 	}
 
-	/* The UCLogic kernel driver returns firmware names with form
-	 * <vendor>_<model>_<version>. Remove the version from `uniq` to avoid
-	 * mismatches on firmware updates. */
-	regex = g_regex_new("(.*_.*)_.*$", 0, 0, NULL);
-	g_regex_match(regex, uniq, 0, &match_info);
-
-	if (g_match_info_matches(match_info)) {
-		gchar *tmp = uniq;
-		uniq = g_match_info_fetch(match_info, 1);
-		g_free(tmp);
+	for (guint i = 0; i < nrules; i++) {
+		char *normalized = uniq_rule_apply(&rules[i], uniq);
+		if (normalized)
+			return normalized;
 	}
 
-	return uniq;
+	return g_strdup(uniq);
 }
 
 static gboolean
-get_device_info(const char *path,
+get_device_info(const WacomDeviceInfo *info,
 		int *vendor_id,
 		int *product_id,
-		char **name,
-		char **uniq,
 		WacomBusType *bus,
-		WacomIntegrationFlags *integration_flags,
 		WacomError *error)
 {
-	g_autoptr(GUdevClient) client = NULL;
-	g_autoptr(GUdevDevice) device = NULL;
-	const char *const subsystems[] = { "input", NULL };
-	gboolean retval;
-	g_autofree char *bus_str;
-	const char *devname;
-
-	retval = FALSE;
-	/* The integration flags from device info are unset by default */
-	*integration_flags =
-		WACOM_DEVICE_INTEGRATED_UNSET; // NOLINT: core.EnumCastOutOfRange
-	*name = NULL;
-	*uniq = NULL;
-	bus_str = NULL;
-	client = g_udev_client_new(subsystems);
-	device = client_query_by_subsystem_and_device_file(client, subsystems[0], path);
-	if (device == NULL)
-		device = g_udev_client_query_by_device_file(client, path);
-	if (device == NULL) {
+	const char *bus_str;
+
+	if (!info->is_tablet_or_touchpad) {
 		libwacom_error_set(error,
 				   WERROR_INVALID_PATH,
-				   "Could not find device '%s' in udev",
-				   path);
-		goto out;
-	}
-
-	/* Touchpads are only for the "Finger" part of Bamboo devices */
-	if (!is_tablet_or_touchpad(device)) {
-		GUdevDevice *parent;
-
-		parent = g_udev_device_get_parent(device);
-		if (!parent || !is_tablet_or_touchpad(parent)) {
-			libwacom_error_set(error,
-					   WERROR_INVALID_PATH,
-					   "Device '%s' is not a tablet",
-					   path);
-			if (parent)
-				g_object_unref(parent);
-			goto out;
-		}
-		g_object_unref(parent);
+				   "Device '%s' is not a tablet",
+				   info->devnode);
+		return FALSE;
 	}
 
-	/* Is the device integrated in display? */
-	devname = g_udev_device_get_name(device);
-	if (devname != NULL) {
-		g_autofree char *sysfs_path = NULL;
-		g_autofree char *contents = NULL;
-
-		sysfs_path = g_build_filename("/sys/class/input",
-					      devname,
-					      "device/properties",
-					      NULL);
-		if (g_file_get_contents(sysfs_path, &contents, NULL, NULL)) {
-			int flag;
-
-			flag = atoi(contents);
-			flag &= (1 << INPUT_PROP_DIRECT) | (1 << INPUT_PROP_POINTER);
-			/*
-			 * To ensure we are dealing with a screen tablet, need
-			 * to check that it has DIRECT and non-POINTER (DIRECT
-			 * alone is not sufficient since it's set for drawing
-			 * tablets as well)
-			 */
-			if (flag == (1 << INPUT_PROP_DIRECT))
-				*integration_flags = WACOM_DEVICE_INTEGRATED_DISPLAY;
-			else
-				*integration_flags = WACOM_DEVICE_INTEGRATED_NONE;
-		}
-	}
-
-	*name = get_device_prop(device, "NAME");
-	*uniq = parse_uniq(get_device_prop(device, "UNIQ"));
-	if (*name == NULL)
-		goto out;
+	if (info->name == NULL)
+		return FALSE;
 
 	/* Parse the PRODUCT attribute (for Bluetooth, USB, I2C) */
-	retval = get_bus_vid_pid(device, bus, vendor_id, product_id, error);
-	if (retval)
-		goto out;
+	if (parse_product(info->product, bus, vendor_id, product_id, error))
+		return TRUE;
 
-	bus_str = get_bus(device);
+	bus_str = device_info_get_bus_str(info);
 	*bus = bus_from_str(bus_str);
 
-	if (*bus == WBUSTYPE_SERIAL) {
-		if (is_touchpad(device))
-			goto out;
-
-		/* The serial bus uses 0:0 as the vid/pid */
-		*vendor_id = 0;
-		*product_id = 0;
-		retval = TRUE;
-	} else {
+	if (*bus != WBUSTYPE_SERIAL) {
 		libwacom_error_set(error,
 				   WERROR_UNKNOWN_MODEL,
 				   "Unsupported bus '%s'",
 				   bus_str);
+		return FALSE;
 	}
 
-out:
-	if (retval == FALSE) {
-		g_free(*name);
-		*name = NULL;
-		g_free(*uniq);
-		*uniq = NULL;
-	}
-	return retval;
+	if (info->is_touchpad)
+		return FALSE;
+
+	/* The serial bus uses 0:0 as the vid/pid */
+	*vendor_id = 0;
+	*product_id = 0;
+
+	return TRUE;
 }
 
 static WacomDevice *
-libwacom_copy(const WacomDevice *device)
+libwacom_copy(const WacomDeviceDatabase *db,
+	      const WacomDevice *device)
 {
 	WacomDevice *d;
-	GHashTableIter iter;
-	gpointer k, v;
 
 	d = g_new0(WacomDevice, 1);
 	g_atomic_ref_count_init(&d->refcnt);
-	d->name = g_strdup(device->name);
-	d->model_name = g_strdup(device->model_name);
-	d->width_mm = device->width_mm;
-	d->height_mm = device->height_mm;
-	d->integration_flags = device->integration_flags;
-	d->layout = g_strdup(device->layout);
-	d->matches = g_array_copy(device->matches);
-	for (guint i = 0; i < device->matches->len; i++) {
-		WacomMatch *m = g_array_index(d->matches, WacomMatch *, i);
-		libwacom_match_ref(m);
-	}
-	d->match = libwacom_match_ref(device->match);
-	if (device->paired)
-		d->paired = libwacom_match_ref(device->paired);
+	/* The strings, matches, styli and details are shared with the
+	 * database's devices */
+	d->arena = libwacom_arena_ref(db->arena);
+	g_atomic_int_inc(&d->arena->live_devices);
+	d->name = device->name;
+	d->model_name = device->model_name;
+	d->layout = device->layout;
+	d->match = device->match;
+	d->matches = device->matches;
+	d->paired = device->paired;
+	d->styli = device->styli;
+	d->details = device->details;
+	d->num_matches = device->num_matches;
 	d->cls = device->cls;
+	d->features = device->features;
+	d->integration_flags = device->integration_flags;
+	d->num_buttons = device->num_buttons;
 	d->num_strips = device->num_strips;
 	d->num_rings = device->num_rings;
 	d->num_dials = device->num_dials;
-	d->features = device->features;
 	d->strips_num_modes = device->strips_num_modes;
 	d->dial_num_modes = device->dial_num_modes;
 	d->dial2_num_modes = device->dial2_num_modes;
 	d->ring_num_modes = device->ring_num_modes;
 	d->ring2_num_modes = device->ring2_num_modes;
-	d->styli = g_array_copy(device->styli);
-	d->deprecated_styli_ids = g_array_copy(device->deprecated_styli_ids);
-	d->status_leds = g_array_copy(device->status_leds);
-
-	d->buttons = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
-	g_hash_table_iter_init(&iter, device->buttons);
-	while (g_hash_table_iter_next(&iter, &k, &v)) {
-		WacomButton *a = v;
-		WacomButton *b = g_memdup2(a, sizeof(WacomButton));
-		g_hash_table_insert(d->buttons, k, b);
-	}
-
-	d->num_keycodes = device->num_keycodes;
-	memcpy(d->keycodes, device->keycodes, sizeof(device->keycodes));
 
 	return d;
 }
 
-static bool
-match_is_equal(const WacomMatch *a,
-	       const WacomMatch *b)
-{
-	return g_str_equal(a->match, b->match);
-}
-
 static bool
 matches_are_equal(const WacomDevice *a,
 		  const WacomDevice *b)
@@ -473,7 +570,7 @@ matches_are_equal(const WacomDevice *a,
 	for (match_a = ma; *match_a; match_a++) {
 		int found = 0;
 		for (match_b = mb; !found && *match_b; match_b++) {
-			if (match_is_equal(*match_a, *match_b))
+			if (libwacom_match_equal(*match_a, *match_b))
 				found = 1;
 		}
 		if (!found)
@@ -508,14 +605,42 @@ libwacom_same_layouts(const WacomDevice *a,
 	return rc;
 }
 
+static gboolean
+libwacom_same_details(const WacomDeviceDetails *a,
+		      const WacomDeviceDetails *b)
+{
+	/* Copies of the same device share them */
+	if (a == b)
+		return TRUE;
+
+	if (a->width_mm != b->width_mm || a->height_mm != b->height_mm)
+		return FALSE;
+
+	if (a->num_status_leds != b->num_status_leds)
+		return FALSE;
+
+	if (a->num_status_leds > 0 &&
+	    memcmp(a->status_leds,
+		   b->status_leds,
+		   sizeof(*a->status_leds) * a->num_status_leds) != 0)
+		return FALSE;
+
+	for (guint i = 0; i < WACOM_MAX_BUTTONS; i++) {
+		const WacomButton *ba = &a->buttons[i];
+		const WacomButton *bb = &b->buttons[i];
+
+		if (ba->flags != bb->flags || ba->code != bb->code)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 LIBWACOM_EXPORT int
 libwacom_compare(const WacomDevice *a,
 		 const WacomDevice *b,
 		 WacomCompareFlags flags)
 {
-	GHashTableIter iter;
-	gpointer k, v;
-
 	g_return_val_if_fail(a || b, 0);
 
 	if (!a || !b)
@@ -527,12 +652,6 @@ libwacom_compare(const WacomDevice *a,
 	if (!g_str_equal(a->name, b->name))
 		return 1;
 
-	if (a->width_mm != b->width_mm || a->height_mm != b->height_mm)
-		return 1;
-
-	if (!libwacom_same_layouts(a, b))
-		return 1;
-
 	if (a->integration_flags != b->integration_flags)
 		return 1;
 
@@ -563,13 +682,13 @@ libwacom_compare(const WacomDevice *a,
 	if (a->ring2_num_modes != b->ring2_num_modes)
 		return 1;
 
-	if (g_hash_table_size(a->buttons) != g_hash_table_size(b->buttons))
+	if (a->num_buttons != b->num_buttons)
 		return 1;
 
 	/* We don't need to check deprecated_stylus_ids because if they differ
 	 * when the real id doesn't that's a bug */
 
-	if (a->styli->len != b->styli->len)
+	if (a->styli->num_styli != b->styli->num_styli)
 		return 1;
 
 	/* This needs to be a deep comparison - our styli array contains
@@ -577,39 +696,26 @@ libwacom_compare(const WacomDevice *a,
 	 * true if the stylus data matches (test-dbverify compares styli
 	 * from two different WacomDeviceDatabase).
 	 */
-	for (guint i = 0; i < a->styli->len; i++) {
-		WacomStylus *as = g_array_index(a->styli, WacomStylus *, i);
-		WacomStylus *bs = g_array_index(b->styli, WacomStylus *, i);
-		if (as->id.tool_id != bs->id.tool_id)
-			return 1;
-	}
-
-	if (a->status_leds->len != b->status_leds->len)
-		return 1;
-
-	if (a->status_leds->len > 0 &&
-	    memcmp(a->status_leds->data,
-		   b->status_leds->data,
-		   g_array_get_element_size(a->status_leds) * a->status_leds->len) != 0)
-		return 1;
-
-	g_hash_table_iter_init(&iter, a->buttons);
-	while (g_hash_table_iter_next(&iter, &k, &v)) {
-		WacomButton *ba = v;
-		WacomButton *bb = g_hash_table_lookup(b->buttons, k);
-
-		if (!bb || ba->flags != bb->flags || ba->code != bb->code)
+	for (guint i = 0; a->styli != b->styli && i < a->styli->num_styli; i++) {
+		if (a->styli->styli[i]->id.tool_id != b->styli->styli[i]->id.tool_id)
 			return 1;
 	}
 
 	if ((a->paired == NULL && b->paired != NULL) ||
 	    (a->paired != NULL && b->paired == NULL) ||
-	    (a->paired && b->paired && !match_is_equal(a->paired, b->paired)))
+	    (a->paired && b->paired && !libwacom_match_equal(a->paired, b->paired)))
 		return 1;
 
 	if ((flags & WCOMPARE_MATCHES) && !matches_are_equal(a, b))
 		return 1;
-	else if (!match_is_equal(a->match, b->match))
+	else if (!libwacom_match_equal(a->match, b->match))
+		return 1;
+
+	/* Last, most devices differ in the above already */
+	if (!libwacom_same_layouts(a, b))
+		return 1;
+
+	if (!libwacom_same_details(a->details, b->details))
 		return 1;
 
 	return 0;
@@ -622,20 +728,20 @@ libwacom_new(const WacomDeviceDatabase *db,
 	     int vendor_id,
 	     int product_id,
 	     WacomBusType bus,
+	     const WacomMatch **match,
 	     WacomError *error)
 {
-	const WacomDevice *device;
-	g_autofree char *match = NULL;
+	WacomMatch key;
 
 	if (!db) {
 		libwacom_error_set(error, WERROR_INVALID_DB, "db is NULL");
 		return NULL;
 	}
 
-	match = make_match_string(name, uniq, bus, vendor_id, product_id);
-	device = libwacom_get_device(db, match);
+	if (!match_key_init(db, &key, name, uniq, bus, vendor_id, product_id))
+		return NULL;
 
-	return device;
+	return libwacom_get_device(db, &key, match);
 }
 
 static bool
@@ -666,31 +772,31 @@ fallback_or_device(const WacomDeviceDatabase *db,
 {
 	WacomDevice *copy = NULL;
 	const WacomDevice *fallback;
-	const char *fallback_name = NULL;
+	WacomMatch key;
 
 	if (device != NULL) {
-		return libwacom_copy(device);
+		return libwacom_copy(db, device);
 	}
 
 	switch (fallback_flags) {
 	case WFALLBACK_NONE:
 		return NULL;
 	case WFALLBACK_GENERIC:
-		fallback_name = "generic";
+		match_key_init(db, &key, NULL, NULL, WBUSTYPE_UNKNOWN, 0, 0);
 		break;
 	default:
 		g_assert_not_reached();
 		break;
 	}
 
-	fallback = libwacom_get_device(db, fallback_name);
+	fallback = libwacom_get_device(db, &key, NULL);
 	if (fallback == NULL)
 		return NULL;
 
-	copy = libwacom_copy(fallback);
+	copy = libwacom_copy(db, fallback);
 	if (name_override != NULL) {
-		g_free(copy->name);
-		copy->name = g_strdup(name_override);
+		copy->name_override = g_strdup(name_override);
+		copy->name = copy->name_override;
 	}
 	return copy;
 }
@@ -771,8 +877,7 @@ libwacom_new_from_builder(const WacomDeviceDatabase *db,
 
 		int vendor_id, product_id;
 		char *name, *uniq;
-		const char *used_match_name = NULL;
-		const char *used_match_uniq = NULL;
+		const WacomMatch *used_match = NULL;
 
 		vendor_id = builder->vendor_id;
 		product_id = builder->product_id;
@@ -807,12 +912,10 @@ libwacom_new_from_builder(const WacomDeviceDatabase *db,
 						      vendor_id,
 						      product_id,
 						      *bus,
+						      &used_match,
 						      error);
-				if (device) {
-					used_match_name = match_name;
-					used_match_uniq = match_uniq;
+				if (device)
 					break;
-				}
 
 				if (approach->name == NULL && approach->uniq == NULL)
 					break;
@@ -827,13 +930,7 @@ libwacom_new_from_builder(const WacomDeviceDatabase *db,
 		if (ret && device != NULL) {
 			/* If this isn't the fallback device: for multiple-match
 			 * devices, set to the one we requested */
-			WacomMatch *used_match = libwacom_match_new(used_match_name,
-								    used_match_uniq,
-								    *bus,
-								    vendor_id,
-								    product_id);
 			libwacom_set_default_match(ret, used_match);
-			libwacom_match_unref(used_match);
 		}
 	}
 
@@ -842,51 +939,408 @@ libwacom_new_from_builder(const WacomDeviceDatabase *db,
 	return ret;
 }
 
-LIBWACOM_EXPORT WacomDevice *
-libwacom_new_from_path(const WacomDeviceDatabase *db,
-		       const char *path,
-		       WacomFallbackFlags fallback,
-		       WacomError *error)
+static gboolean
+get_node_identity(const WacomUdevBackend *backend,
+		  const char *path,
+		  WacomNodeIdentity *identity)
 {
-	int vendor_id, product_id;
-	WacomBusType bus;
-	WacomDevice *device;
-	WacomIntegrationFlags integration_flags;
-	g_autofree char *name = NULL;
-	g_autofree char *uniq = NULL;
-	WacomBuilder *builder;
+	g_autofree char *syspath = NULL;
+	struct stat st;
 
-	if (!path) {
-		libwacom_error_set(error, WERROR_INVALID_PATH, "path is NULL");
-		return NULL;
+	if (stat(path, &st) < 0)
+		return FALSE;
+
+	identity->rdev = st.st_rdev;
+	identity->node_ino = st.st_ino;
+
+	/* stat() follows the symlink to the device's sysfs directory */
+	if (S_ISCHR(st.st_mode)) {
+		syspath = g_strdup_printf("%s/dev/char/%u:%u",
+					  backend->sysfs_root,
+					  major(st.st_rdev),
+					  minor(st.st_rdev));
+	} else {
+		g_autofree char *sysname = g_path_get_basename(path);
+		syspath = g_build_filename(backend->sysfs_root,
+					   "class/input",
+					   sysname,
+					   NULL);
 	}
 
-	if (!get_device_info(path,
-			     &vendor_id,
-			     &product_id,
-			     &name,
-			     &uniq,
-			     &bus,
-			     &integration_flags,
-			     error))
-		return NULL;
+	if (stat(syspath, &st) < 0)
+		return FALSE;
 
-	builder = libwacom_builder_new();
-	libwacom_builder_set_match_name(builder, name);
-	libwacom_builder_set_device_name(builder, name);
-	libwacom_builder_set_bustype(builder, bus);
-	libwacom_builder_set_uniq(builder, uniq);
-	libwacom_builder_set_usbid(builder, vendor_id, product_id);
-	device = libwacom_new_from_builder(db, builder, fallback, error);
-	/* if unset, use the kernel flags. Could be unset as well. */
-	if (device && device->integration_flags == WACOM_DEVICE_INTEGRATED_UNSET)
-		device->integration_flags = integration_flags;
+	identity->sysfs_ino = st.st_ino;
+
+	return TRUE;
+}
+
+static gboolean
+node_identity_equal(const WacomNodeIdentity *a,
+		    const WacomNodeIdentity *b)
+{
+	return a->rdev == b->rdev && a->node_ino == b->node_ino &&
+	       a->sysfs_ino == b->sysfs_ino;
+}
+
+void
+path_cache_entry_free(WacomPathCacheEntry *entry)
+{
+	libwacom_unref(entry->device);
+	g_free(entry);
+}
+
+static WacomDevice *
+path_cache_lookup(WacomDeviceDatabase *db,
+		  const char *path,
+		  const WacomNodeIdentity *identity,
+		  WacomFallbackFlags fallback)
+{
+	WacomDevice *device = NULL;
+	WacomPathCacheEntry *entry;
+
+	g_mutex_lock(&db->path_cache_lock);
+	if (db->path_cache) {
+		entry = g_hash_table_lookup(db->path_cache, path);
+		if (entry && !node_identity_equal(&entry->identity, identity))
+			g_hash_table_remove(db->path_cache, path);
+		else if (entry && entry->fallback == fallback)
+			device = libwacom_ref(entry->device);
+	}
+	g_mutex_unlock(&db->path_cache_lock);
+
+	return device;
+}
+
+static void
+path_cache_remove(WacomDeviceDatabase *db,
+		  const char *path)
+{
+	g_mutex_lock(&db->path_cache_lock);
+	if (db->path_cache)
+		g_hash_table_remove(db->path_cache, path);
+	g_mutex_unlock(&db->path_cache_lock);
+}
+
+static void
+path_cache_insert(WacomDeviceDatabase *db,
+		  const char *path,
+		  const WacomNodeIdentity *identity,
+		  WacomFallbackFlags fallback,
+		  WacomDevice *device)
+{
+	WacomPathCacheEntry *entry;
+
+	g_mutex_lock(&db->path_cache_lock);
+	if (db->path_cache) {
+		entry = g_new0(WacomPathCacheEntry, 1);
+		entry->identity = *identity;
+		entry->fallback = fallback;
+		entry->device = libwacom_ref(device);
+		g_hash_table_replace(db->path_cache, g_strdup(path), entry);
+	}
+	g_mutex_unlock(&db->path_cache_lock);
+}
+
+LIBWACOM_EXPORT WacomDevice *
+libwacom_new_from_path(const WacomDeviceDatabase *db,
+		       const char *path,
+		       WacomFallbackFlags fallback,
+		       WacomError *error)
+{
+	int vendor_id, product_id;
+	WacomBusType bus;
+	WacomDevice *device;
+	g_autoptr(WacomDeviceInfo) info = NULL;
+	g_autofree char *uniq = NULL;
+	WacomBuilder *builder;
+	WacomNodeIdentity identity;
+	gboolean cacheable = FALSE;
+
+	if (!path) {
+		libwacom_error_set(error, WERROR_INVALID_PATH, "path is NULL");
+		return NULL;
+	}
+
+	/* The identity is taken before the udev lookup so a node replaced
+	 * in the meantime can't end up cached with the new identity */
+	if (db && g_atomic_pointer_get((GHashTable **)&db->path_cache)) {
+		/* The cache is the only mutable part of the database */
+		WacomDeviceDatabase *mutable_db = (WacomDeviceDatabase *)db;
+
+		cacheable = get_node_identity(db->udev, path, &identity);
+		if (cacheable) {
+			device = path_cache_lookup(mutable_db, path, &identity, fallback);
+			if (device)
+				return device;
+		} else {
+			path_cache_remove(mutable_db, path);
+		}
+	}
+
+	info = device_info_new_from_path(db ? db->udev : &udev_backend_gudev,
+					 path,
+					 error);
+	if (!info)
+		return NULL;
+
+	if (!get_device_info(info, &vendor_id, &product_id, &bus, error))
+		return NULL;
+
+	uniq = parse_uniq(db, info->uniq);
+
+	builder = libwacom_builder_new();
+	libwacom_builder_set_match_name(builder, info->name);
+	libwacom_builder_set_device_name(builder, info->name);
+	libwacom_builder_set_bustype(builder, bus);
+	libwacom_builder_set_uniq(builder, uniq);
+	libwacom_builder_set_usbid(builder, vendor_id, product_id);
+	device = libwacom_new_from_builder(db, builder, fallback, error);
+	/* if unset, use the kernel flags. Could be unset as well. */
+	if (device && device->integration_flags == WACOM_DEVICE_INTEGRATED_UNSET)
+		device->integration_flags = info->integration_flags;
+
+	if (device && cacheable)
+		path_cache_insert((WacomDeviceDatabase *)db,
+				  path,
+				  &identity,
+				  fallback,
+				  device);
 
 	libwacom_builder_destroy(builder);
 
 	return device;
 }
 
+G_DEFINE_QUARK(libwacom-error-quark, libwacom_error)
+
+/* Protects all databases' path_requests and the waiters, global because a
+ * waiter may be cancelled after its database is gone */
+static GMutex path_request_lock;
+
+void
+libwacom_path_requests_lock(void)
+{
+	g_mutex_lock(&path_request_lock);
+}
+
+void
+libwacom_path_requests_unlock(void)
+{
+	g_mutex_unlock(&path_request_lock);
+}
+
+struct path_waiter {
+	WacomPathRequest *request; /* NULL once removed from the request */
+	GSource *cancel_source;
+};
+
+static void
+path_waiter_free(struct path_waiter *waiter)
+{
+	if (waiter->cancel_source) {
+		g_source_destroy(waiter->cancel_source);
+		g_source_unref(waiter->cancel_source);
+	}
+	g_free(waiter);
+}
+
+static void
+path_request_free(WacomPathRequest *request)
+{
+	g_free(request->key);
+	g_free(request->path);
+	g_clear_pointer(&request->waiters, g_ptr_array_unref);
+	g_object_unref(request->cancellable);
+	libwacom_database_unref(request->db);
+	g_free(request);
+}
+
+/* Called with path_request_lock held. Later requests for the same path
+ * start a new lookup */
+static void
+path_request_detach(WacomPathRequest *request)
+{
+	GHashTable *requests = request->db->path_requests;
+
+	if (g_hash_table_lookup(requests, request->key) == request)
+		g_hash_table_remove(requests, request->key);
+}
+
+static gboolean
+path_waiter_cancelled(GCancellable *cancellable,
+		      gpointer data)
+{
+	g_autoptr(GTask) task = g_object_ref(data);
+	struct path_waiter *waiter = g_task_get_task_data(task);
+	g_autoptr(GCancellable) lookup_cancellable = NULL;
+	WacomPathRequest *request;
+
+	g_mutex_lock(&path_request_lock);
+	request = g_steal_pointer(&waiter->request);
+	if (request) {
+		g_ptr_array_remove(request->waiters, task);
+		if (request->waiters->len == 0) {
+			path_request_detach(request);
+			lookup_cancellable = g_object_ref(request->cancellable);
+		}
+	}
+	g_mutex_unlock(&path_request_lock);
+
+	/* Nobody is interested in the result anymore */
+	if (lookup_cancellable)
+		g_cancellable_cancel(lookup_cancellable);
+
+	if (request)
+		g_task_return_error_if_cancelled(task);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+path_request_thread(GTask *worker,
+		    gpointer source_object,
+		    gpointer task_data,
+		    GCancellable *cancellable)
+{
+	WacomPathRequest *request = task_data;
+	g_autoptr(GPtrArray) waiters = NULL;
+	WacomError *error = libwacom_error_new();
+	WacomDevice *device = NULL;
+
+	if (!g_cancellable_is_cancelled(cancellable))
+		device = libwacom_new_from_path(request->db,
+						request->path,
+						request->fallback,
+						error);
+
+	g_mutex_lock(&path_request_lock);
+	path_request_detach(request);
+	waiters = g_steal_pointer(&request->waiters);
+	for (guint i = 0; i < waiters->len; i++) {
+		struct path_waiter *waiter =
+			g_task_get_task_data(g_ptr_array_index(waiters, i));
+		waiter->request = NULL;
+	}
+	g_mutex_unlock(&path_request_lock);
+
+	/* Waiters cancelled by now get G_IO_ERROR_CANCELLED from GTask */
+	for (guint i = 0; i < waiters->len; i++) {
+		GTask *task = g_ptr_array_index(waiters, i);
+
+		if (device)
+			g_task_return_pointer(task,
+					      libwacom_ref(device),
+					      (GDestroyNotify)libwacom_unref);
+		else
+			g_task_return_new_error(task,
+						libwacom_error_quark(),
+						error->code,
+						"%s",
+						error->msg ? error->msg : "");
+	}
+
+	libwacom_unref(device);
+	libwacom_error_free(&error);
+	g_task_return_boolean(worker, TRUE);
+}
+
+LIBWACOM_EXPORT void
+libwacom_new_from_path_async(const WacomDeviceDatabase *db,
+			     const char *path,
+			     WacomFallbackFlags fallback,
+			     GCancellable *cancellable,
+			     GAsyncReadyCallback callback,
+			     void *user_data)
+{
+	g_autoptr(GTask) task = NULL;
+	g_autofree char *key = NULL;
+	struct path_waiter *waiter;
+	WacomPathRequest *request;
+	gboolean start_lookup = FALSE;
+
+	task = g_task_new(NULL, cancellable, callback, user_data);
+	g_task_set_source_tag(task, libwacom_new_from_path_async);
+
+	if (!db) {
+		g_task_return_new_error(task,
+					libwacom_error_quark(),
+					WERROR_INVALID_DB,
+					"db is NULL");
+		return;
+	}
+
+	if (!path) {
+		g_task_return_new_error(task,
+					libwacom_error_quark(),
+					WERROR_INVALID_PATH,
+					"path is NULL");
+		return;
+	}
+
+	waiter = g_new0(struct path_waiter, 1);
+	g_task_set_task_data(task, waiter, (GDestroyNotify)path_waiter_free);
+
+	key = g_strdup_printf("%d:%s", fallback, path);
+
+	g_mutex_lock(&path_request_lock);
+	request = g_hash_table_lookup(db->path_requests, key);
+	if (!request) {
+		request = g_new0(WacomPathRequest, 1);
+		request->db = libwacom_database_ref((WacomDeviceDatabase *)db);
+		request->key = g_steal_pointer(&key);
+		request->path = g_strdup(path);
+		request->fallback = fallback;
+		request->waiters = g_ptr_array_new_with_free_func(g_object_unref);
+		request->cancellable = g_cancellable_new();
+		g_hash_table_insert(db->path_requests, request->key, request);
+		start_lookup = TRUE;
+	}
+	waiter->request = request;
+	g_ptr_array_add(request->waiters, g_object_ref(task));
+	g_mutex_unlock(&path_request_lock);
+
+	if (cancellable) {
+		waiter->cancel_source = g_cancellable_source_new(cancellable);
+		g_task_attach_source(task,
+				     waiter->cancel_source,
+				     (GSourceFunc)path_waiter_cancelled);
+	}
+
+	/* The request is only freed by its worker, so it's safe to use
+	 * outside the lock until then */
+	if (start_lookup) {
+		g_autoptr(GTask) worker = g_task_new(NULL, request->cancellable, NULL, NULL);
+
+		g_task_set_task_data(worker, request, (GDestroyNotify)path_request_free);
+		g_task_run_in_thread(worker, path_request_thread);
+	}
+}
+
+LIBWACOM_EXPORT WacomDevice *
+libwacom_new_from_path_finish(GAsyncResult *result,
+			      WacomError *error)
+{
+	g_autoptr(GError) gerror = NULL;
+	WacomDevice *device;
+
+	g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+	g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) ==
+				     libwacom_new_from_path_async,
+			     NULL);
+
+	device = g_task_propagate_pointer(G_TASK(result), &gerror);
+	if (device)
+		return device;
+
+	if (g_error_matches(gerror, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		libwacom_error_set(error, WERROR_CANCELLED, "%s", gerror->message);
+	else if (gerror && gerror->code != WERROR_NONE)
+		libwacom_error_set(error, gerror->code, "%s", gerror->message);
+
+	return NULL;
+}
+
 LIBWACOM_EXPORT WacomDevice *
 libwacom_new_from_usbid(const WacomDeviceDatabase *db,
 			int vendor_id,
@@ -1126,8 +1580,8 @@ print_match(int fd,
 	int product = libwacom_match_get_product_id(match);
 	const char *bus_name;
 
-	if (g_str_equal(match->match, GENERIC_DEVICE_MATCH)) {
-		dprintf(fd, "%s;", match->match);
+	if (match_is_generic(match)) {
+		dprintf(fd, "%s;", GENERIC_DEVICE_MATCH);
 		return;
 	}
 
@@ -1227,8 +1681,8 @@ libwacom_print_device_description(int fd,
 	}
 
 	dprintf(fd, "Class=%s\n", class_name);
-	dprintf(fd, "Width=%d\n", device->width_mm);
-	dprintf(fd, "Height=%d\n", device->height_mm);
+	dprintf(fd, "Width=%d\n", device->details->width_mm);
+	dprintf(fd, "Height=%d\n", device->details->height_mm);
 	print_integrated_flags_for_device(fd, device);
 	print_layout_for_device(fd, device);
 	print_styli_for_device(fd, device);
@@ -1255,6 +1709,56 @@ libwacom_print_device_description(int fd,
 	print_buttons_for_device(fd, device);
 }
 
+LIBWACOM_EXPORT int
+libwacom_print_udev_info(int fd,
+			 const char *path,
+			 WacomError *error)
+{
+	g_autoptr(WacomDeviceInfo) info = NULL;
+	const char *integrated;
+
+	if (!path) {
+		libwacom_error_set(error, WERROR_INVALID_PATH, "path is NULL");
+		return -1;
+	}
+
+	info = device_info_new_from_path(&udev_backend_gudev, path, error);
+	if (!info)
+		return -1;
+
+	switch (info->integration_flags) {
+	case WACOM_DEVICE_INTEGRATED_NONE:
+		integrated = "none";
+		break;
+	case WACOM_DEVICE_INTEGRATED_DISPLAY:
+		integrated = "display";
+		break;
+	default:
+		integrated = "unset";
+		break;
+	}
+
+	dprintf(fd, "[UdevInfo]\n");
+	dprintf(fd, "DevNode=%s\n", info->devnode);
+	dprintf(fd, "SysName=%s\n", info->sysname ? info->sysname : "");
+	dprintf(fd, "Name=%s\n", info->name ? info->name : "");
+	dprintf(fd, "Uniq=%s\n", info->uniq ? info->uniq : "");
+	dprintf(fd, "Product=%s\n", info->product ? info->product : "");
+	dprintf(fd, "Subsystem=%s\n", info->subsystem ? info->subsystem : "");
+	dprintf(fd, "UinputDevice=%s\n", info->is_uinput ? "true" : "false");
+	dprintf(fd,
+		"UinputSubsystem=%s\n",
+		info->uinput_subsystem ? info->uinput_subsystem : "");
+	dprintf(fd, "Bus=%s\n", device_info_get_bus_str(info));
+	dprintf(fd,
+		"TabletOrTouchpad=%s\n",
+		info->is_tablet_or_touchpad ? "true" : "false");
+	dprintf(fd, "Touchpad=%s\n", info->is_touchpad ? "true" : "false");
+	dprintf(fd, "IntegratedIn=%s\n", integrated);
+
+	return 0;
+}
+
 WacomDevice *
 libwacom_ref(WacomDevice *device)
 {
@@ -1271,19 +1775,10 @@ libwacom_unref(WacomDevice *device)
 	if (!g_atomic_ref_count_dec(&device->refcnt))
 		return NULL;
 
-	g_free(device->name);
-	g_free(device->model_name);
-	g_free(device->layout);
-	if (device->paired)
-		libwacom_match_unref(device->paired);
-	for (guint i = 0; i < device->matches->len; i++)
-		libwacom_match_unref(g_array_index(device->matches, WacomMatch *, i));
-	g_clear_pointer(&device->matches, g_array_unref);
-	libwacom_match_unref(device->match);
-	g_clear_pointer(&device->styli, g_array_unref);
-	g_clear_pointer(&device->deprecated_styli_ids, g_array_unref);
-	g_clear_pointer(&device->status_leds, g_array_unref);
-	g_clear_pointer(&device->buttons, g_hash_table_destroy);
+	g_free(device->name_override);
+	if (device->arena)
+		g_atomic_int_add(&device->arena->live_devices, -1);
+	libwacom_arena_unref(device->arena);
 	g_free(device);
 
 	return NULL;
@@ -1296,52 +1791,70 @@ libwacom_destroy(WacomDevice *device)
 }
 
 WacomMatch *
-libwacom_match_ref(WacomMatch *match)
+libwacom_match_new(WacomArena *arena,
+		   const char *name,
+		   const char *uniq,
+		   WacomBusType bus,
+		   int vendor_id,
+		   int product_id)
 {
-	g_atomic_ref_count_inc(&match->refcnt);
+	WacomMatch *match;
+
+	match = arena_alloc(&arena->objects, sizeof(*match));
+	match->name = libwacom_arena_intern(arena, name);
+	match->uniq = libwacom_arena_intern(arena, uniq);
+	match->arena = arena;
+	match->bus = bus;
+	match->vendor_id = vendor_id;
+	match->product_id = product_id;
+
 	return match;
 }
 
-WacomMatch *
-libwacom_match_unref(WacomMatch *match)
+/* In the match string an empty name and no name are the same if
+ * there is a uniq */
+static inline const char *
+match_key_name(const WacomMatch *match)
 {
-	if (match == NULL || !g_atomic_ref_count_dec(&match->refcnt))
+	if (match->uniq && match->name && match->name[0] == '\0')
 		return NULL;
+	return match->name;
+}
 
-	g_free(match->match);
-	g_free(match->name);
-	g_free(match->uniq);
-	g_free(match);
-
-	return NULL;
+static inline bool
+str_equal(const char *a,
+	  const char *b)
+{
+	return a == b || (a && b && g_str_equal(a, b));
 }
 
-WacomMatch *
-libwacom_match_new(const char *name,
-		   const char *uniq,
-		   WacomBusType bus,
-		   int vendor_id,
-		   int product_id)
+/* Only for matches from the same database, the strings are hashed by
+ * their interned pointer */
+guint
+libwacom_match_hash(gconstpointer data)
 {
-	WacomMatch *match;
-	char *newmatch;
+	const WacomMatch *match = data;
+	guint hash;
 
-	match = g_malloc(sizeof(*match));
-	g_atomic_ref_count_init(&match->refcnt);
-	if (name == NULL && bus == WBUSTYPE_UNKNOWN && vendor_id == 0 &&
-	    product_id == 0)
-		newmatch = g_strdup("generic");
-	else
-		newmatch = make_match_string(name, uniq, bus, vendor_id, product_id);
+	hash = match->bus;
+	hash = hash * 31 + match->vendor_id;
+	hash = hash * 31 + match->product_id;
+	hash = hash * 31 + g_direct_hash(match_key_name(match));
+	hash = hash * 31 + g_direct_hash(match->uniq);
 
-	match->match = newmatch;
-	match->name = g_strdup(name);
-	match->uniq = g_strdup(uniq);
-	match->bus = bus;
-	match->vendor_id = vendor_id;
-	match->product_id = product_id;
+	return hash;
+}
 
-	return match;
+gboolean
+libwacom_match_equal(gconstpointer data_a,
+		     gconstpointer data_b)
+{
+	const WacomMatch *a = data_a, *b = data_b;
+
+	return a->bus == b->bus && a->vendor_id == b->vendor_id &&
+	       a->product_id == b->product_id &&
+	       str_equal(match_key_name(a), match_key_name(b)) &&
+	       str_equal(a->uniq, b->uniq);
 }
 
 LIBWACOM_EXPORT WacomBuilder *
@@ -1400,32 +1913,15 @@ libwacom_builder_set_uniq(WacomBuilder *builder,
 	builder->uniq = g_strdup(uniq);
 }
 
-void
-libwacom_add_match(WacomDevice *device,
-		   WacomMatch *newmatch)
-{
-	for (guint i = 0; i < device->matches->len; i++) {
-		WacomMatch *m = g_array_index(device->matches, WacomMatch *, i);
-		const char *matchstr = libwacom_match_get_match_string(m);
-
-		if (g_str_equal(matchstr, newmatch->match)) {
-			return;
-		}
-	}
-	libwacom_match_ref(newmatch);
-	g_array_append_val(device->matches, newmatch);
-}
-
 void
 libwacom_set_default_match(WacomDevice *device,
-			   WacomMatch *newmatch)
+			   const WacomMatch *match)
 {
-	for (guint i = 0; i < device->matches->len; i++) {
-		WacomMatch *m = g_array_index(device->matches, WacomMatch *, i);
+	for (guint i = 0; i < device->num_matches; i++) {
+		WacomMatch *m = device->matches[i];
 
-		if (match_is_equal(m, newmatch)) {
-			libwacom_match_unref(device->match);
-			device->match = libwacom_match_ref(m);
+		if (m == match || libwacom_match_equal(m, match)) {
+			device->match = m;
 			return;
 		}
 	}
@@ -1468,13 +1964,13 @@ LIBWACOM_EXPORT const char *
 libwacom_get_match(const WacomDevice *device)
 {
 	g_return_val_if_fail(device->match, NULL);
-	return device->match->match;
+	return libwacom_match_get_match_string(device->match);
 }
 
 LIBWACOM_EXPORT const WacomMatch **
 libwacom_get_matches(const WacomDevice *device)
 {
-	return (const WacomMatch **)device->matches->data;
+	return (const WacomMatch **)device->matches;
 }
 
 LIBWACOM_EXPORT const WacomMatch *
@@ -1486,25 +1982,25 @@ libwacom_get_paired_device(const WacomDevice *device)
 LIBWACOM_EXPORT int
 libwacom_get_width(const WacomDevice *device)
 {
-	return (int)(device->width_mm / 25.4 + 0.5);
+	return (int)(device->details->width_mm / 25.4 + 0.5);
 }
 
 LIBWACOM_EXPORT int
 libwacom_get_height(const WacomDevice *device)
 {
-	return (int)(device->height_mm / 25.4 + 0.5);
+	return (int)(device->details->height_mm / 25.4 + 0.5);
 }
 
 LIBWACOM_EXPORT int
 libwacom_get_width_mm(const WacomDevice *device)
 {
-	return device->width_mm;
+	return device->details->width_mm;
 }
 
 LIBWACOM_EXPORT int
 libwacom_get_height_mm(const WacomDevice *device)
 {
-	return device->height_mm;
+	return device->details->height_mm;
 }
 
 LIBWACOM_EXPORT WacomClass
@@ -1541,32 +2037,82 @@ libwacom_has_touch(const WacomDevice *device)
 LIBWACOM_EXPORT int
 libwacom_get_num_buttons(const WacomDevice *device)
 {
-	return g_hash_table_size(device->buttons);
+	return device->num_buttons;
 }
 
 LIBWACOM_EXPORT int
 libwacom_get_num_keys(const WacomDevice *device)
 {
-	return device->num_keycodes;
+	return device->details->num_keycodes;
+}
+
+/* The legacy PID-only stylus id lists. These only ever worked for Wacom
+ * styli, so let's keep that behavior */
+static void
+append_deprecated_id(GArray *ids,
+		     const WacomStylusId *id)
+{
+	if (id->vid == 0 || id->vid == WACOM_VENDOR_ID)
+		g_array_append_val(ids, id->tool_id);
+}
+
+static int *
+deprecated_ids_dup(WacomArena *arena,
+		   GArray *ids)
+{
+	int *dup;
+
+	g_mutex_lock(&arena->lock);
+	dup = arena_memdup(&arena->details, ids->data, ids->len * sizeof(int));
+	g_mutex_unlock(&arena->lock);
+
+	return dup;
+}
+
+/* The set is shared by all devices with the same styli, possibly
+ * between threads */
+const int *
+libwacom_styli_set_get_deprecated_ids(WacomStyliSet *set,
+				      guint *num_ids)
+{
+	if (g_once_init_enter(&set->deprecated_ids_once)) {
+		g_autoptr(GArray) ids = g_array_new(FALSE, FALSE, sizeof(int));
+
+		for (guint i = 0; i < set->num_styli; i++)
+			append_deprecated_id(ids, &set->styli[i]->id);
+
+		set->num_deprecated_ids = ids->len;
+		set->deprecated_ids = deprecated_ids_dup(set->arena, ids);
+		g_once_init_leave(&set->deprecated_ids_once, 1);
+	}
+
+	*num_ids = set->num_deprecated_ids;
+	return set->deprecated_ids;
 }
 
 LIBWACOM_EXPORT const int *
 libwacom_get_supported_styli(const WacomDevice *device,
 			     int *num_styli)
 {
-	*num_styli = device->deprecated_styli_ids->len;
-	return (const int *)device->deprecated_styli_ids->data;
+	guint count;
+	const int *ids;
+
+	ids = libwacom_styli_set_get_deprecated_ids((WacomStyliSet *)device->styli,
+						    &count);
+	*num_styli = count;
+
+	return ids;
 }
 
 LIBWACOM_EXPORT const WacomStylus **
 libwacom_get_styli(const WacomDevice *device,
 		   int *num_styli)
 {
-	int count = device->styli->len;
+	int count = device->styli->num_styli;
 	const WacomStylus **styli = g_new0(const WacomStylus *, count + 1);
 
 	if (count > 0)
-		memcpy(styli, device->styli->data, count * sizeof(WacomStylus *));
+		memcpy(styli, device->styli->styli, count * sizeof(WacomStylus *));
 
 	if (num_styli)
 		*num_styli = count;
@@ -1574,6 +2120,107 @@ libwacom_get_styli(const WacomDevice *device,
 	return styli;
 }
 
+LIBWACOM_EXPORT const WacomStylusSummary *
+libwacom_get_stylus_summary(const WacomDevice *device)
+{
+	return &device->styli->summary;
+}
+
+/* Bindings rely on this layout */
+G_STATIC_ASSERT(sizeof(WacomButtonDescriptor) == 16);
+G_STATIC_ASSERT(sizeof(WacomKeyDescriptor) == 8);
+G_STATIC_ASSERT(sizeof(WacomMatchDescriptor) == 8);
+G_STATIC_ASSERT(sizeof(WacomStylusIdDescriptor) == 8);
+G_STATIC_ASSERT(sizeof(WacomStylusRecord) == 40);
+G_STATIC_ASSERT(G_N_ELEMENTS(((WacomDeviceDescriptor *)0)->buttons) ==
+		WACOM_MAX_BUTTONS);
+G_STATIC_ASSERT(G_N_ELEMENTS(((WacomDeviceDescriptor *)0)->keys) ==
+		WACOM_MAX_KEYCODES);
+
+static void
+match_descriptor(WacomMatchDescriptor *d,
+		 const WacomMatch *match)
+{
+	d->bustype = match->bus;
+	d->vendor_id = match->vendor_id;
+	d->product_id = match->product_id;
+}
+
+LIBWACOM_EXPORT int
+libwacom_device_get_descriptor(const WacomDevice *device,
+			       WacomDeviceDescriptor *descriptor,
+			       size_t size)
+{
+	const WacomDeviceDetails *details = device->details;
+	WacomDeviceDescriptor d = {
+		.version = WACOM_DEVICE_DESCRIPTOR_VERSION,
+		.size = MIN(size, sizeof(d)),
+		.integration_flags = libwacom_get_integration_flags(device),
+		.width_mm = details->width_mm,
+		.height_mm = details->height_mm,
+		.has_stylus = libwacom_has_stylus(device),
+		.has_touch = libwacom_has_touch(device),
+		.has_touchswitch = libwacom_has_touchswitch(device),
+		.is_reversible = libwacom_is_reversible(device),
+		.num_rings = device->num_rings,
+		.num_strips = device->num_strips,
+		.num_dials = device->num_dials,
+		.ring_num_modes = device->ring_num_modes,
+		.ring2_num_modes = device->ring2_num_modes,
+		.strips_num_modes = device->strips_num_modes,
+		.dial_num_modes = device->dial_num_modes,
+		.dial2_num_modes = device->dial2_num_modes,
+		.num_buttons = device->num_buttons,
+		.num_keys = details->num_keycodes,
+	};
+
+	if (size < offsetof(WacomDeviceDescriptor, flags))
+		return -1;
+
+	if (device->match)
+		match_descriptor(&d.match, device->match);
+	if (device->paired)
+		match_descriptor(&d.paired, device->paired);
+
+	for (guint i = 0; i < WACOM_MAX_BUTTONS; i++) {
+		const WacomButton *b = &details->buttons[i];
+
+		d.buttons[i].flags = b->flags;
+		d.buttons[i].code = b->code;
+		d.buttons[i].mode = libwacom_get_button_modeswitch_mode(device, 'A' + i);
+		d.buttons[i].led_group = details->button_led_groups[i];
+	}
+
+	for (guint i = 0; i < details->num_keycodes; i++) {
+		d.keys[i].type = details->keycodes[i].type;
+		d.keys[i].code = details->keycodes[i].code;
+	}
+
+	d.num_status_leds = MIN(details->num_status_leds, G_N_ELEMENTS(d.status_leds));
+	for (guint i = 0; i < d.num_status_leds; i++)
+		d.status_leds[i] = details->status_leds[i];
+
+	d.num_styli = MIN(device->styli->num_styli, G_N_ELEMENTS(d.styli));
+	for (guint i = 0; i < d.num_styli; i++) {
+		d.styli[i].vendor_id = device->styli->styli[i]->id.vid;
+		d.styli[i].tool_id = device->styli->styli[i]->id.tool_id;
+	}
+
+	d.num_matches = MIN(device->num_matches, G_N_ELEMENTS(d.matches));
+	for (guint i = 0; i < d.num_matches; i++)
+		match_descriptor(&d.matches[i], device->matches[i]);
+
+	if (d.num_styli < device->styli->num_styli ||
+	    d.num_matches < device->num_matches)
+		d.flags |= WACOM_DEVICE_DESCRIPTOR_TRUNCATED;
+
+	memcpy(descriptor, &d, d.size);
+	if (size > sizeof(d))
+		memset((char *)descriptor + sizeof(d), 0, size - sizeof(d));
+
+	return 0;
+}
+
 LIBWACOM_EXPORT int
 libwacom_has_ring(const WacomDevice *device)
 {
@@ -1638,8 +2285,8 @@ LIBWACOM_EXPORT const WacomStatusLEDs *
 libwacom_get_status_leds(const WacomDevice *device,
 			 int *num_leds)
 {
-	*num_leds = device->status_leds->len;
-	return (const WacomStatusLEDs *)device->status_leds->data;
+	*num_leds = device->details->num_status_leds;
+	return device->details->status_leds;
 }
 
 static const struct {
@@ -1654,30 +2301,70 @@ static const struct {
 	{ WACOM_BUTTON_DIAL2_MODESWITCH, WACOM_STATUS_LED_DIAL2 },
 };
 
-LIBWACOM_EXPORT int
-libwacom_get_button_led_group(const WacomDevice *device,
-			      char button)
+static const WacomButton *
+get_button(const WacomDevice *device,
+	   char button)
 {
-	WacomButton *b = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(button));
+	const WacomButton *b;
 
-	if (!b || !(b->flags & WACOM_BUTTON_MODESWITCH))
-		return -1;
+	if (button < 'A' || button > 'Z')
+		return NULL;
 
-	for (guint led_index = 0; led_index < device->status_leds->len; led_index++) {
-		guint n;
+	b = &device->details->buttons[button - 'A'];
 
-		for (n = 0; n < G_N_ELEMENTS(button_status_leds); n++) {
-			WacomStatusLEDs led = g_array_index(device->status_leds,
-							    WacomStatusLEDs,
-							    led_index);
-			if ((b->flags & button_status_leds[n].button_flags) &&
-			    (led == button_status_leds[n].status_leds)) {
-				return led_index;
+	return b->flags != WACOM_BUTTON_NONE ? b : NULL;
+}
+
+/* Called once the status LEDs and the buttons are known */
+void
+libwacom_setup_button_led_groups(WacomDevice *device)
+{
+	WacomDeviceDetails *details = device->details;
+
+	for (guint i = 0; i < WACOM_MAX_BUTTONS; i++) {
+		const WacomButton *b = &details->buttons[i];
+
+		details->button_led_groups[i] = -1;
+		if (!(b->flags & WACOM_BUTTON_MODESWITCH))
+			continue;
+
+		for (guint led_index = 0; led_index < details->num_status_leds;
+		     led_index++) {
+			WacomStatusLEDs led = details->status_leds[led_index];
+			guint n;
+
+			for (n = 0; n < G_N_ELEMENTS(button_status_leds); n++) {
+				if ((b->flags & button_status_leds[n].button_flags) &&
+				    (led == button_status_leds[n].status_leds))
+					break;
+			}
+
+			if (n < G_N_ELEMENTS(button_status_leds)) {
+				details->button_led_groups[i] = led_index;
+				break;
 			}
 		}
 	}
+}
 
-	return -1;
+LIBWACOM_EXPORT int
+libwacom_get_button_led_group(const WacomDevice *device,
+			      char button)
+{
+	if (button < 'A' || button > 'Z')
+		return -1;
+
+	return device->details->button_led_groups[button - 'A'];
+}
+
+LIBWACOM_EXPORT const int *
+libwacom_get_button_led_groups(const WacomDevice *device,
+			       int *num_buttons)
+{
+	if (num_buttons)
+		*num_buttons = device->num_buttons;
+
+	return device->details->button_led_groups;
 }
 
 LIBWACOM_EXPORT int
@@ -1720,7 +2407,7 @@ LIBWACOM_EXPORT WacomButtonFlags
 libwacom_get_button_flag(const WacomDevice *device,
 			 char button)
 {
-	WacomButton *b = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(button));
+	const WacomButton *b = get_button(device, button);
 
 	return b ? b->flags : WACOM_BUTTON_NONE;
 }
@@ -1729,7 +2416,7 @@ LIBWACOM_EXPORT int
 libwacom_get_button_evdev_code(const WacomDevice *device,
 			       char button)
 {
-	WacomButton *b = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(button));
+	const WacomButton *b = get_button(device, button);
 
 	return b ? b->code : 0;
 }
@@ -1738,7 +2425,7 @@ LIBWACOM_EXPORT WacomModeSwitch
 libwacom_get_button_modeswitch_mode(const WacomDevice *device,
 				    char button)
 {
-	WacomButton *b = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(button));
+	const WacomButton *b = get_button(device, button);
 
 	if (!b || (b->flags & WACOM_BUTTON_MODESWITCH) == 0)
 		return WACOM_MODE_SWITCH_NEXT;
@@ -1746,6 +2433,191 @@ libwacom_get_button_modeswitch_mode(const WacomDevice *device,
 	return b->mode;
 }
 
+LIBWACOM_EXPORT char
+libwacom_get_button_for_evdev_code(const WacomDevice *device,
+				   unsigned int evdev_code)
+{
+	unsigned int idx = evdev_code - WACOM_BUTTON_CODE_MIN;
+
+	if (idx >= WACOM_NUM_BUTTON_CODES)
+		return 0;
+
+	return device->details->button_for_code[idx];
+}
+
+LIBWACOM_EXPORT int
+libwacom_get_key_for_code(const WacomDevice *device,
+			  unsigned int type,
+			  unsigned int code)
+{
+	const WacomDeviceDetails *details = device->details;
+	guint slot = wacom_keycode_slot(type, code);
+
+	/* The table always has empty slots, see index_key_codes() */
+	while (details->key_for_code[slot] != 0) {
+		guint idx = details->key_for_code[slot] - 1;
+
+		if (details->keycodes[idx].type == type &&
+		    details->keycodes[idx].code == code)
+			return idx;
+		slot = (slot + 1) % WACOM_KEYCODE_SLOTS;
+	}
+
+	return -1;
+}
+
+static int
+modeswitch_num_modes(const WacomDevice *device,
+		     WacomButtonFlags flag)
+{
+	switch (flag) {
+	case WACOM_BUTTON_RING_MODESWITCH:
+		return device->ring_num_modes;
+	case WACOM_BUTTON_RING2_MODESWITCH:
+		return device->ring2_num_modes;
+	case WACOM_BUTTON_TOUCHSTRIP_MODESWITCH:
+	case WACOM_BUTTON_TOUCHSTRIP2_MODESWITCH:
+		return device->strips_num_modes;
+	case WACOM_BUTTON_DIAL_MODESWITCH:
+		return device->dial_num_modes;
+	case WACOM_BUTTON_DIAL2_MODESWITCH:
+		return device->dial2_num_modes;
+	default:
+		return 0;
+	}
+}
+
+LIBWACOM_EXPORT WacomPadModeTracker *
+libwacom_pad_mode_tracker_new(const WacomDevice *device)
+{
+	const WacomDeviceDetails *details;
+	WacomPadModeTracker *tracker;
+
+	g_return_val_if_fail(device != NULL, NULL);
+
+	details = device->details;
+	tracker = g_new0(WacomPadModeTracker, 1);
+	memset(tracker->button_group, -1, sizeof(tracker->button_group));
+
+	/* button_status_leds has the features in group order */
+	for (guint n = 0; n < G_N_ELEMENTS(button_status_leds); n++) {
+		WacomButtonFlags flag = button_status_leds[n].button_flags;
+		int group = tracker->num_groups;
+		gboolean has_buttons = FALSE;
+
+		for (guint i = 0; i < WACOM_MAX_BUTTONS; i++) {
+			const WacomButton *b = &details->buttons[i];
+
+			if (!(b->flags & flag) || tracker->button_group[i] != -1)
+				continue;
+
+			tracker->button_group[i] = group;
+			tracker->button_mode[i] = b->mode;
+			has_buttons = TRUE;
+		}
+
+		if (!has_buttons)
+			continue;
+
+		tracker->groups[group].num_modes =
+			MAX(modeswitch_num_modes(device, flag), 1);
+		tracker->groups[group].led_group = -1;
+		for (guint led = 0; led < details->num_status_leds; led++) {
+			if (details->status_leds[led] == button_status_leds[n].status_leds) {
+				tracker->groups[group].led_group = led;
+				break;
+			}
+		}
+		tracker->num_groups++;
+	}
+
+	return tracker;
+}
+
+LIBWACOM_EXPORT void
+libwacom_pad_mode_tracker_destroy(WacomPadModeTracker *tracker)
+{
+	g_free(tracker);
+}
+
+LIBWACOM_EXPORT int
+libwacom_pad_mode_tracker_button_pressed(WacomPadModeTracker *tracker,
+					 char button,
+					 int *mode)
+{
+	int group, target;
+
+	if (button < 'A' || button > 'Z')
+		return -1;
+
+	group = tracker->button_group[button - 'A'];
+	if (group < 0)
+		return -1;
+
+	target = tracker->button_mode[button - 'A'];
+	if (target == WACOM_MODE_SWITCH_NEXT)
+		target = (tracker->groups[group].mode + 1) % tracker->groups[group].num_modes;
+
+	/* A mode beyond the number of modes is a data bug, ignore it */
+	if (target >= 0 && target < tracker->groups[group].num_modes)
+		tracker->groups[group].mode = target;
+
+	if (mode)
+		*mode = tracker->groups[group].mode;
+
+	return group;
+}
+
+LIBWACOM_EXPORT int
+libwacom_pad_mode_tracker_get_num_groups(const WacomPadModeTracker *tracker)
+{
+	return tracker->num_groups;
+}
+
+LIBWACOM_EXPORT int
+libwacom_pad_mode_tracker_get_mode(const WacomPadModeTracker *tracker,
+				   int group)
+{
+	if (group < 0 || (guint)group >= tracker->num_groups)
+		return -1;
+
+	return tracker->groups[group].mode;
+}
+
+LIBWACOM_EXPORT int
+libwacom_pad_mode_tracker_set_mode(WacomPadModeTracker *tracker,
+				   int group,
+				   int mode)
+{
+	if (group < 0 || (guint)group >= tracker->num_groups ||
+	    mode < 0 || mode >= tracker->groups[group].num_modes)
+		return 0;
+
+	tracker->groups[group].mode = mode;
+
+	return 1;
+}
+
+LIBWACOM_EXPORT int
+libwacom_pad_mode_tracker_get_num_modes(const WacomPadModeTracker *tracker,
+					int group)
+{
+	if (group < 0 || (guint)group >= tracker->num_groups)
+		return -1;
+
+	return tracker->groups[group].num_modes;
+}
+
+LIBWACOM_EXPORT int
+libwacom_pad_mode_tracker_get_led_group(const WacomPadModeTracker *tracker,
+					int group)
+{
+	if (group < 0 || (guint)group >= tracker->num_groups)
+		return -1;
+
+	return tracker->groups[group].led_group;
+}
+
 static const WacomStylus *
 libwacom_stylus_get_for_stylus_id(const WacomDeviceDatabase *db,
 				  const WacomStylusId *id)
@@ -1753,27 +2625,241 @@ libwacom_stylus_get_for_stylus_id(const WacomDeviceDatabase *db,
 	return g_hash_table_lookup(db->stylus_ht, id);
 }
 
-LIBWACOM_EXPORT const WacomStylus *
-libwacom_stylus_get_for_id(const WacomDeviceDatabase *db,
-			   int tool_id)
+/* The generic styli are stored with vendor id 0 and found for any vendor */
+static unsigned int
+stylus_lookup_vid(int vendor_id,
+		  int tool_id)
 {
-	WacomStylusId id = {
-		.vid = WACOM_VENDOR_ID,
-		.tool_id = tool_id,
-	};
-
 	switch (tool_id) {
 	case GENERIC_PEN_WITH_ERASER:
 	case GENERIC_ERASER:
 	case GENERIC_PEN_NO_ERASER:
 	case GENERIC_PEN_3BTN_WITH_ERASER:
 	case GENERIC_ERASER_3BTN:
-		id.vid = 0;
-		break;
+		return 0;
 	}
+
+	return vendor_id;
+}
+
+LIBWACOM_EXPORT const WacomStylus *
+libwacom_stylus_get_for_id(const WacomDeviceDatabase *db,
+			   int tool_id)
+{
+	WacomStylusId id = {
+		.vid = stylus_lookup_vid(WACOM_VENDOR_ID, tool_id),
+		.tool_id = tool_id,
+	};
+
 	return libwacom_stylus_get_for_stylus_id(db, &id);
 }
 
+LIBWACOM_EXPORT const WacomStylus *
+libwacom_stylus_get_for_vid_and_id(const WacomDeviceDatabase *db,
+				   int vendor_id,
+				   int tool_id)
+{
+	const WacomVendorStyli *vendor = NULL;
+	unsigned int vid = stylus_lookup_vid(vendor_id, tool_id);
+	guint lo = 0, hi;
+
+	g_return_val_if_fail(db != NULL, NULL);
+
+	/* A handful of vendors */
+	for (guint i = 0; i < db->num_vendors; i++) {
+		if (db->vendors[i].vid == vid) {
+			vendor = &db->vendors[i];
+			break;
+		}
+	}
+	if (!vendor)
+		return NULL;
+
+	hi = vendor->num_styli;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		unsigned int id = vendor->styli[mid]->id.tool_id;
+
+		if (id == (unsigned int)tool_id)
+			return vendor->styli[mid];
+		if (id < (unsigned int)tool_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+/* Assigns the next offset in the string table to str if it has none yet.
+ * The strings are interned so the pointer is the key */
+static void
+export_string(GHashTable *offsets,
+	      const char *str,
+	      size_t *strings_size)
+{
+	if (g_hash_table_contains(offsets, str))
+		return;
+
+	g_hash_table_insert(offsets, (gpointer)str, GSIZE_TO_POINTER(*strings_size));
+	*strings_size += strlen(str) + 1;
+}
+
+LIBWACOM_EXPORT int
+libwacom_database_export_styli(const WacomDeviceDatabase *db,
+			       const WacomDevice *device,
+			       WacomStylusTable *table)
+{
+	g_autoptr(GHashTable) indices = NULL;
+	g_autoptr(GHashTable) offsets = NULL;
+	const WacomStylus *const *styli;
+	size_t num_styli, num_paired = 0, strings_size = 0;
+	GHashTableIter iter;
+	gpointer key, value;
+	size_t paired = 0;
+	gboolean fits;
+
+	g_return_val_if_fail(db != NULL, -1);
+	g_return_val_if_fail(table != NULL, -1);
+
+	if (device) {
+		styli = (const WacomStylus *const *)device->styli->styli;
+		num_styli = device->styli->num_styli;
+	} else {
+		styli = db->stylus_table;
+		num_styli = g_hash_table_size(db->stylus_ht);
+	}
+
+	/* Stylus to record index + 1, so a missing stylus is NULL */
+	indices = g_hash_table_new(NULL, NULL);
+	offsets = g_hash_table_new(NULL, NULL);
+	for (size_t i = 0; i < num_styli; i++)
+		g_hash_table_insert(indices,
+				    (gpointer)styli[i],
+				    GSIZE_TO_POINTER(i + 1));
+
+	for (size_t i = 0; i < num_styli; i++) {
+		const WacomStylus *stylus = styli[i];
+
+		for (guint j = 0; j < stylus->num_paired_styli; j++) {
+			if (g_hash_table_contains(indices, stylus->paired_styli[j]))
+				num_paired++;
+		}
+		export_string(offsets, stylus->name, &strings_size);
+	}
+
+	fits = table->num_records >= num_styli && table->num_paired >= num_paired &&
+	       table->strings_size >= strings_size;
+	table->num_records = num_styli;
+	table->num_paired = num_paired;
+	table->strings_size = strings_size;
+	if (!fits)
+		return -1;
+
+	g_hash_table_iter_init(&iter, offsets);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		const char *str = key;
+
+		memcpy(table->strings + GPOINTER_TO_SIZE(value), str, strlen(str) + 1);
+	}
+
+	for (size_t i = 0; i < num_styli; i++) {
+		const WacomStylus *stylus = styli[i];
+		WacomStylusRecord *record = &table->records[i];
+		uint32_t flags = 0;
+
+		if (stylus->has_eraser)
+			flags |= WACOM_STYLUS_RECORD_HAS_ERASER;
+		if (stylus->eraser_type != WACOM_ERASER_NONE)
+			flags |= WACOM_STYLUS_RECORD_IS_ERASER;
+		if (stylus->has_lens)
+			flags |= WACOM_STYLUS_RECORD_HAS_LENS;
+		if (stylus->has_wheel)
+			flags |= WACOM_STYLUS_RECORD_HAS_WHEEL;
+		if (stylus->is_generic_stylus)
+			flags |= WACOM_STYLUS_RECORD_IS_GENERIC;
+
+		*record = (WacomStylusRecord){
+			.vendor_id = stylus->id.vid,
+			.tool_id = stylus->id.tool_id,
+			.name = GPOINTER_TO_SIZE(
+				g_hash_table_lookup(offsets, stylus->name)),
+			.axes = stylus->axes,
+			.flags = flags,
+			.type = stylus_type_or_default(stylus),
+			.eraser_type = stylus->eraser_type,
+			.num_buttons = stylus_num_buttons_or_default(stylus),
+			.paired_first = paired,
+		};
+
+		for (guint j = 0; j < stylus->num_paired_styli; j++) {
+			gpointer index =
+				g_hash_table_lookup(indices, stylus->paired_styli[j]);
+
+			if (index)
+				table->paired[paired++] = GPOINTER_TO_SIZE(index) - 1;
+		}
+		record->num_paired = paired - record->paired_first;
+	}
+
+	return 0;
+}
+
+LIBWACOM_EXPORT WacomStylusResolver *
+libwacom_stylus_resolver_new(WacomDeviceDatabase *db,
+			     const WacomDevice *device)
+{
+	WacomStylusResolver *resolver;
+
+	g_return_val_if_fail(db != NULL, NULL);
+	g_return_val_if_fail(device != NULL, NULL);
+
+	resolver = g_new0(WacomStylusResolver, 1);
+	resolver->db = libwacom_database_ref(db);
+	resolver->num_styli = g_hash_table_size(db->stylus_ht);
+
+	resolver->supported = g_new0(guint32, (resolver->num_styli + 31) / 32);
+	for (guint i = 0; i < device->styli->num_styli; i++) {
+		guint index = device->styli->styli[i]->index;
+
+		if (index < resolver->num_styli)
+			resolver->supported[index / 32] |= 1U << (index % 32);
+	}
+
+	return resolver;
+}
+
+LIBWACOM_EXPORT void
+libwacom_stylus_resolver_destroy(WacomStylusResolver *resolver)
+{
+	if (!resolver)
+		return;
+
+	libwacom_database_unref(resolver->db);
+	g_free(resolver->supported);
+	g_free(resolver);
+}
+
+LIBWACOM_EXPORT const WacomStylus *
+libwacom_stylus_resolver_lookup(const WacomStylusResolver *resolver,
+				int vendor_id,
+				int tool_id)
+{
+	return libwacom_stylus_get_for_vid_and_id(resolver->db, vendor_id, tool_id);
+}
+
+LIBWACOM_EXPORT int
+libwacom_stylus_resolver_is_supported(const WacomStylusResolver *resolver,
+				      const WacomStylus *stylus)
+{
+	guint index = stylus->index;
+
+	if (index >= resolver->num_styli)
+		return 0;
+
+	return (resolver->supported[index / 32] >> (index % 32)) & 1;
+}
+
 LIBWACOM_EXPORT int
 libwacom_stylus_get_id(const WacomStylus *stylus)
 {
@@ -1792,42 +2878,90 @@ libwacom_stylus_get_name(const WacomStylus *stylus)
 	return stylus->name;
 }
 
+const int *
+libwacom_stylus_get_deprecated_paired_ids(WacomStylus *s,
+					  guint *num_ids)
+{
+	WacomStylusDetails *details = s->details;
+
+	if (g_once_init_enter(&details->deprecated_paired_ids_once)) {
+		g_autoptr(GArray) ids = g_array_new(FALSE, FALSE, sizeof(int));
+
+		for (guint i = 0; i < details->num_paired_stylus_ids; i++)
+			append_deprecated_id(ids, &details->paired_stylus_ids[i]);
+
+		details->num_deprecated_paired_ids = ids->len;
+		details->deprecated_paired_ids = deprecated_ids_dup(details->arena, ids);
+		g_once_init_leave(&details->deprecated_paired_ids_once, 1);
+	}
+
+	*num_ids = details->num_deprecated_paired_ids;
+	return details->deprecated_paired_ids;
+}
+
 LIBWACOM_EXPORT const int *
 libwacom_stylus_get_paired_ids(const WacomStylus *stylus,
 			       int *num_paired_ids)
 {
+	guint count;
+	const int *ids;
+
+	ids = libwacom_stylus_get_deprecated_paired_ids((WacomStylus *)stylus,
+							&count);
 	if (num_paired_ids)
-		*num_paired_ids = stylus->deprecated_paired_ids->len;
-	return (const int *)stylus->deprecated_paired_ids->data;
+		*num_paired_ids = count;
+
+	return ids;
 }
 
 LIBWACOM_EXPORT const WacomStylus **
 libwacom_stylus_get_paired_styli(const WacomStylus *stylus,
 				 int *num_paired)
 {
-	int count = stylus->paired_styli->len;
+	int count = stylus->num_paired_styli;
 	const WacomStylus **styli = g_new0(const WacomStylus *, count + 1);
 
 	if (num_paired)
 		*num_paired = count;
 
 	if (count > 0)
-		memcpy(styli,
-		       stylus->paired_styli->data,
-		       count * sizeof(WacomStylus *));
+		memcpy(styli, stylus->paired_styli, count * sizeof(WacomStylus *));
 	return styli;
 }
 
+LIBWACOM_EXPORT const WacomStylus *
+libwacom_stylus_get_paired_eraser(const WacomStylus *stylus)
+{
+	return stylus->paired_eraser;
+}
+
+LIBWACOM_EXPORT const WacomStylus *
+libwacom_stylus_get_paired_pen(const WacomStylus *stylus)
+{
+	return stylus->paired_pen;
+}
+
+LIBWACOM_EXPORT WacomDevice *const *
+libwacom_stylus_list_devices(const WacomStylus *stylus,
+			     int *num_devices)
+{
+	static WacomDevice *const no_devices[] = { NULL };
+	const WacomStylusDetails *details = stylus->details;
+
+	if (num_devices)
+		*num_devices = details->num_devices;
+
+	return details->devices ? details->devices : no_devices;
+}
+
 LIBWACOM_EXPORT int
 libwacom_stylus_get_num_buttons(const WacomStylus *stylus)
 {
-	if (stylus->num_buttons == -1) {
+	if (stylus->num_buttons == -1)
 		g_warning(
 			"Stylus '0x%x' has no number of buttons defined, falling back to 2",
 			stylus->id.tool_id);
-		return 2;
-	}
-	return stylus->num_buttons;
+	return stylus_num_buttons_or_default(stylus);
 }
 
 LIBWACOM_EXPORT int
@@ -1869,13 +3003,11 @@ libwacom_stylus_get_axes(const WacomStylus *stylus)
 LIBWACOM_EXPORT WacomStylusType
 libwacom_stylus_get_type(const WacomStylus *stylus)
 {
-	if (stylus->type == WSTYLUS_UNKNOWN) {
+	if (stylus->type == WSTYLUS_UNKNOWN)
 		g_warning(
 			"Stylus '0x%x' has no type defined, falling back to 'General'",
 			stylus->id.tool_id);
-		return WSTYLUS_GENERAL;
-	}
-	return stylus->type;
+	return stylus_type_or_default(stylus);
 }
 
 LIBWACOM_EXPORT WacomEraserType
@@ -1992,30 +3124,6 @@ libwacom_print_stylus_description(int fd,
 	dprintf(fd, "Type=%s\n", type);
 }
 
-WacomStylus *
-libwacom_stylus_ref(WacomStylus *stylus)
-{
-	g_atomic_ref_count_inc(&stylus->refcnt);
-
-	return stylus;
-}
-
-WacomStylus *
-libwacom_stylus_unref(WacomStylus *stylus)
-{
-	if (stylus == NULL || !g_atomic_ref_count_dec(&stylus->refcnt))
-		return NULL;
-
-	g_free(stylus->name);
-	g_free(stylus->group);
-	g_clear_pointer(&stylus->deprecated_paired_ids, g_array_unref);
-	g_clear_pointer(&stylus->paired_stylus_ids, g_array_unref);
-	g_clear_pointer(&stylus->paired_styli, g_array_unref);
-	g_free(stylus);
-
-	return NULL;
-}
-
 LIBWACOM_EXPORT const char *
 libwacom_match_get_name(const WacomMatch *match)
 {
@@ -2049,7 +3157,33 @@ libwacom_match_get_vendor_id(const WacomMatch *match)
 LIBWACOM_EXPORT const char *
 libwacom_match_get_match_string(const WacomMatch *match)
 {
-	return match->match;
+	/* The match is shared by all copies of a device, possibly
+	 * between threads */
+	WacomMatch *m = (WacomMatch *)match;
+	char *str = g_atomic_pointer_get(&m->match);
+
+	if (str)
+		return str;
+
+	g_mutex_lock(&m->arena->lock);
+	str = m->match;
+	if (!str) {
+		g_autofree char *formatted = NULL;
+
+		if (match_is_generic(m))
+			formatted = g_strdup(GENERIC_DEVICE_MATCH);
+		else
+			formatted = make_match_string(m->name,
+						      m->uniq,
+						      m->bus,
+						      m->vendor_id,
+						      m->product_id);
+		str = arena_strdup(&m->arena->strings, formatted);
+		g_atomic_pointer_set(&m->match, str);
+	}
+	g_mutex_unlock(&m->arena->lock);
+
+	return str;
 }
 
 /* vim: set noexpandtab tabstop=8 shiftwidth=8: */
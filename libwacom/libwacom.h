@@ -108,6 +108,16 @@ typedef struct _WacomMatch WacomMatch;
  */
 typedef struct _WacomStylus WacomStylus;
 
+/**
+ * @ingroup styli
+ */
+typedef struct _WacomStylusResolver WacomStylusResolver;
+
+/**
+ * @ingroup devices
+ */
+typedef struct _WacomPadModeTracker WacomPadModeTracker;
+
 /**
  * @ingroup context
  */
@@ -118,6 +128,11 @@ typedef struct _WacomError WacomError;
  */
 typedef struct _WacomDeviceDatabase WacomDeviceDatabase;
 
+/* For libwacom_new_from_path_async() without including GIO */
+struct _GCancellable;
+struct _GObject;
+struct _GAsyncResult;
+
 /**
  * @ingroup styli
  */
@@ -140,6 +155,7 @@ enum WacomErrorCode {
 	WERROR_BAD_ACCESS,    /**< Invalid permissions to access the path */
 	WERROR_UNKNOWN_MODEL, /**< Unsupported/unknown device */
 	WERROR_BUG_CALLER,    /**< A bug in the caller */
+	WERROR_CANCELLED,     /**< The operation was cancelled, since 2.20 */
 };
 
 /**
@@ -290,6 +306,27 @@ typedef enum {
 	WACOM_AXIS_TYPE_SLIDER = (1 << 5),
 } WacomAxisTypeFlags;
 
+/**
+ * What the styli of a device can do, combined, see
+ * libwacom_get_stylus_summary(). Each field is what the respective
+ * libwacom_stylus_*() getter returns, merged over all styli. Fields may
+ * be appended in future versions.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+typedef struct {
+	int num_styli;
+	WacomAxisTypeFlags axes_any; /**< the axes of at least one stylus */
+	WacomAxisTypeFlags axes_all; /**< the axes of every stylus */
+	int max_buttons;
+	int has_eraser; /**< at least one stylus has an eraser */
+	int has_lens;   /**< at least one stylus has a lens */
+	int has_wheel;  /**< at least one stylus has a wheel */
+	uint32_t eraser_types; /**< a bitmask of 1 << WacomEraserType */
+	uint32_t types;        /**< a bitmask of 1 << WacomStylusType */
+} WacomStylusSummary;
+
 /**
  * @ingroup devices
  */
@@ -316,6 +353,209 @@ typedef enum {
 	WACOM_STATUS_LED_DIAL2 = 5,
 } WacomStatusLEDs;
 
+/**
+ * The memory used by a database, see libwacom_database_get_stats().
+ *
+ * Strings shared between objects are only counted in strings_bytes, the
+ * hash table sizes are an estimate. Fields may be appended in future
+ * versions.
+ *
+ * @ingroup context
+ * @since 2.20
+ */
+typedef struct {
+	size_t num_devices;
+	size_t devices_bytes; /**< excluding the buttons */
+	size_t num_matches;
+	size_t matches_bytes;
+	size_t num_styli;
+	size_t styli_bytes;
+	size_t num_buttons;
+	size_t buttons_bytes;
+	size_t num_strings;
+	size_t strings_bytes;
+	size_t num_hash_tables;
+	size_t hash_table_bytes;
+	size_t num_handles;   /**< devices returned to the caller, not yet destroyed */
+	size_t handles_bytes;
+	size_t arena_bytes; /**< everything above but the hash tables and handles,
+			      including unused space */
+} WacomDatabaseStats;
+
+/**
+ * The current version of WacomDeviceDescriptor, see
+ * libwacom_device_get_descriptor().
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+#define WACOM_DEVICE_DESCRIPTOR_VERSION 1
+
+/**
+ * The capacity of the stylus and match arrays of a WacomDeviceDescriptor
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+#define WACOM_DEVICE_DESCRIPTOR_MAX_STYLI 64
+#define WACOM_DEVICE_DESCRIPTOR_MAX_MATCHES 16
+
+/**
+ * Set in WacomDeviceDescriptor.flags if the device has more styli or
+ * matches than the descriptor holds
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+#define WACOM_DEVICE_DESCRIPTOR_TRUNCATED (1 << 0)
+
+/**
+ * A button in a WacomDeviceDescriptor
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+typedef struct {
+	uint32_t flags;    /**< WacomButtonFlags, WACOM_BUTTON_NONE if unused */
+	uint32_t code;     /**< see libwacom_get_button_evdev_code() */
+	int32_t mode;      /**< see libwacom_get_button_modeswitch_mode() */
+	int32_t led_group; /**< see libwacom_get_button_led_group() */
+} WacomButtonDescriptor;
+
+/**
+ * A key in a WacomDeviceDescriptor
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+typedef struct {
+	uint32_t type; /**< the evdev event type, EV_KEY or EV_SW */
+	uint32_t code; /**< the evdev event code */
+} WacomKeyDescriptor;
+
+/**
+ * A match in a WacomDeviceDescriptor
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+typedef struct {
+	uint32_t bustype; /**< WacomBusType */
+	uint16_t vendor_id;
+	uint16_t product_id;
+} WacomMatchDescriptor;
+
+/**
+ * A stylus in a WacomDeviceDescriptor
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+typedef struct {
+	uint32_t vendor_id;
+	uint32_t tool_id;
+} WacomStylusIdDescriptor;
+
+/**
+ * Everything but the strings a device getter returns, in one fixed-size
+ * struct without pointers so it can be copied as is into shared memory
+ * or a socket. See libwacom_device_get_descriptor().
+ *
+ * Fields are only ever appended, the version is bumped when that
+ * happens. The button array is indexed by button - 'A'.
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+typedef struct {
+	uint32_t version; /**< the version the library filled in */
+	uint32_t size;    /**< the number of bytes the library filled in */
+	uint32_t flags;   /**< e.g. WACOM_DEVICE_DESCRIPTOR_TRUNCATED */
+
+	WacomMatchDescriptor match; /**< see libwacom_get_vendor_id(), etc. */
+	WacomMatchDescriptor paired; /**< see libwacom_get_paired_device(),
+					  bustype is WBUSTYPE_UNKNOWN if unset */
+	uint32_t integration_flags; /**< WacomIntegrationFlags */
+	int32_t width_mm;
+	int32_t height_mm;
+	int32_t has_stylus;
+	int32_t has_touch;
+	int32_t has_touchswitch;
+	int32_t is_reversible;
+
+	int32_t num_rings;
+	int32_t num_strips;
+	int32_t num_dials;
+	int32_t ring_num_modes;
+	int32_t ring2_num_modes;
+	int32_t strips_num_modes;
+	int32_t dial_num_modes;
+	int32_t dial2_num_modes;
+
+	uint32_t num_buttons;
+	WacomButtonDescriptor buttons[26];
+	uint32_t num_keys;
+	WacomKeyDescriptor keys[32];
+	uint32_t num_status_leds;
+	int32_t status_leds[6]; /**< WacomStatusLEDs */
+	uint32_t num_styli;
+	WacomStylusIdDescriptor styli[WACOM_DEVICE_DESCRIPTOR_MAX_STYLI];
+	uint32_t num_matches;
+	WacomMatchDescriptor matches[WACOM_DEVICE_DESCRIPTOR_MAX_MATCHES];
+} WacomDeviceDescriptor;
+
+/**
+ * The flags of a WacomStylusRecord
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+typedef enum {
+	WACOM_STYLUS_RECORD_HAS_ERASER = (1 << 0), /**< libwacom_stylus_has_eraser() */
+	WACOM_STYLUS_RECORD_IS_ERASER = (1 << 1),  /**< libwacom_stylus_is_eraser() */
+	WACOM_STYLUS_RECORD_HAS_LENS = (1 << 2),   /**< libwacom_stylus_has_lens() */
+	WACOM_STYLUS_RECORD_HAS_WHEEL = (1 << 3),  /**< libwacom_stylus_has_wheel() */
+	WACOM_STYLUS_RECORD_IS_GENERIC = (1 << 4), /**< a generic stylus */
+} WacomStylusRecordFlags;
+
+/**
+ * A stylus in a WacomStylusTable, without pointers so an array of them
+ * can be copied as is into shared memory. The layout never changes.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+typedef struct {
+	uint32_t vendor_id;
+	uint32_t tool_id;
+	uint32_t name;  /**< offset into the string table */
+	uint32_t axes;  /**< WacomAxisTypeFlags */
+	uint32_t flags; /**< WacomStylusRecordFlags */
+	int32_t type;   /**< see libwacom_stylus_get_type() */
+	int32_t eraser_type; /**< see libwacom_stylus_get_eraser_type() */
+	int32_t num_buttons; /**< see libwacom_stylus_get_num_buttons() */
+	uint32_t paired_first; /**< the first paired entry of this stylus */
+	uint32_t num_paired;   /**< the number of paired entries */
+} WacomStylusRecord;
+
+/**
+ * The caller-provided buffers for libwacom_database_export_styli(). Each
+ * count is the capacity of the buffer on input and the size required on
+ * output.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+typedef struct {
+	WacomStylusRecord *records;
+	size_t num_records;
+	uint32_t *paired; /**< indices into records, see
+			    WacomStylusRecord.paired_first */
+	size_t num_paired;
+	char *strings; /**< nul-terminated strings, see WacomStylusRecord.name */
+	size_t strings_size;
+} WacomStylusTable;
+
 typedef enum {
 	IGNORE_ALIASES = 0,
 	ONLY_ALIASES = 1,
@@ -452,6 +692,108 @@ libwacom_database_ref(WacomDeviceDatabase *db);
 WacomDeviceDatabase *
 libwacom_database_unref(WacomDeviceDatabase *db);
 
+/**
+ * Enable or disable caching of libwacom_new_from_path() results in this
+ * database. The cache is disabled by default.
+ *
+ * With the cache enabled, a repeated lookup of the same device node
+ * skips the udev queries and returns a new reference to the device
+ * returned by the first lookup. The cache entry is discarded when the
+ * device node or its sysfs device changes, e.g. when the node is reused
+ * for a newly plugged device. Unsuccessful lookups are not cached.
+ *
+ * Disabling the cache releases all cached devices.
+ *
+ * @param db A Tablet and Stylus database.
+ * @param enabled Non-zero to enable the cache, zero to disable it
+ *
+ * @ingroup context
+ * @since 2.20
+ */
+void
+libwacom_database_set_path_cache(WacomDeviceDatabase *db,
+				 int enabled);
+
+/**
+ * Count the objects in this database and the memory they use.
+ *
+ * Devices returned by libwacom_new_from_builder() and friends are counted
+ * as handles until they are destroyed, including those held by the path
+ * cache, see libwacom_database_set_path_cache(). Handles that outlive the
+ * database are no longer counted anywhere.
+ *
+ * @param db A Tablet and Stylus database.
+ * @return A newly allocated WacomDatabaseStats. Use free() to free it.
+ *
+ * @ingroup context
+ * @since 2.20
+ */
+WacomDatabaseStats *
+libwacom_database_get_stats(WacomDeviceDatabase *db);
+
+/**
+ * Seal the database's devices, styli, matches and strings into read-only
+ * pages.
+ *
+ * Everything libwacom would otherwise build on first use is built now,
+ * afterwards nothing writes to those pages again. Devices handed out by
+ * the database are separate allocations that do not touch them either,
+ * so a process that forks after this call keeps sharing the pages with
+ * its children.
+ *
+ * The database remains fully usable. Calling this function more than
+ * once has no effect.
+ *
+ * @param db A Tablet and Stylus database.
+ * @return Non-zero on success, zero if the pages could not be made
+ * read-only. The database remains usable either way.
+ *
+ * @ingroup context
+ * @since 2.20
+ */
+int
+libwacom_database_freeze(WacomDeviceDatabase *db);
+
+/**
+ * Export the database as an image in a sealed memfd, see
+ * libwacom_database_new_from_fd(). The fd can be passed to other
+ * processes on the same machine, e.g. over a Unix socket.
+ *
+ * The image is only valid for the same build of libwacom.
+ *
+ * @param db A Tablet and Stylus database.
+ * @param error If not NULL, set to the error if any occurs
+ * @return A new file descriptor or -1 on error. The caller must close it.
+ *
+ * @ingroup context
+ * @since 2.20
+ */
+int
+libwacom_database_export_fd(WacomDeviceDatabase *db,
+			    WacomError *error);
+
+/**
+ * Load a database from an image created by libwacom_database_export_fd().
+ *
+ * The image is mapped read-only and its memory is shared with every
+ * other process that maps the same image, only the small records that
+ * point to each other, such as devices and styli, are copied. The image
+ * is validated before use, an image from a different build of libwacom
+ * is rejected.
+ *
+ * @param fd The sealed memfd returned by libwacom_database_export_fd().
+ * It is not used once this function returns, the caller must close it.
+ * @param error If not NULL, set to the error if any occurs
+ * @return A new database or NULL on error. Use
+ * libwacom_database_destroy() to free it.
+ *
+ * @ingroup context
+ * @since 2.20
+ */
+WacomDeviceDatabase *
+libwacom_database_new_from_fd(int fd,
+			      WacomError *error);
+
 /**
  * Create a new device reference for the given builder.
  * In case of error, NULL is returned and the error is set to the
@@ -506,6 +848,57 @@ libwacom_new_from_path(const WacomDeviceDatabase *db,
 		       WacomFallbackFlags fallback,
 		       WacomError *error);
 
+/**
+ * Asynchronous version of libwacom_new_from_path(). The udev queries and
+ * the database lookup run in a worker thread, the callback is invoked in
+ * the thread-default main context of the caller. Call
+ * libwacom_new_from_path_finish() from the callback to obtain the device.
+ *
+ * Concurrent requests for the same path and fallback share a single
+ * lookup and thus all return a reference to the same device.
+ *
+ * The types are the GIO GCancellable, GAsyncReadyCallback and
+ * GAsyncResult, spelled out so this header doesn't require GIO. The
+ * source object passed to the callback is always NULL.
+ *
+ * @param db A device database
+ * @param path A device path in the form of e.g. /dev/input/event0
+ * @param fallback Whether we should create a generic if model is unknown
+ * @param cancellable A GCancellable or NULL
+ * @param callback The callback to invoke once the lookup has finished
+ * @param user_data Passed to the callback
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+void
+libwacom_new_from_path_async(const WacomDeviceDatabase *db,
+			     const char *path,
+			     WacomFallbackFlags fallback,
+			     struct _GCancellable *cancellable,
+			     void (*callback)(struct _GObject *source_object,
+					      struct _GAsyncResult *result,
+					      void *user_data),
+			     void *user_data);
+
+/**
+ * Finish a lookup started with libwacom_new_from_path_async().
+ * In case of error, NULL is returned and the error is set to the
+ * appropriate value. If the lookup was cancelled, the error code is
+ * WERROR_CANCELLED.
+ *
+ * @param result The GAsyncResult passed to the callback
+ * @param error If not NULL, set to the error if any occurs
+ *
+ * @return A new reference to this device or NULL on error.
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+WacomDevice *
+libwacom_new_from_path_finish(struct _GAsyncResult *result,
+			      WacomError *error);
+
 /**
  * Create a new device reference from the given vendor/product IDs.
  * In case of error, NULL is returned and the error is set to the
@@ -594,6 +987,30 @@ void
 libwacom_print_device_description(int fd,
 				  const WacomDevice *device);
 
+/**
+ * Print the udev properties libwacom uses to identify the device at the
+ * given path to the given file. This is a debugging aid, the output
+ * format is not stable.
+ *
+ * The properties are collected from the event node and its ancestors the
+ * same way libwacom_new_from_path() does, but no lookup in the database
+ * takes place and the device does not need to be a tablet.
+ *
+ * @param fd The file descriptor to print to
+ * @param path The event node path of the device, e.g. /dev/input/event0
+ * @param error If not NULL, set to the error if any occurs
+ *
+ * @return 0 on success or a negative value if the device could not be
+ * found in udev
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_print_udev_info(int fd,
+			 const char *path,
+			 WacomError *error);
+
 /**
  * Remove the device and free all memory and references to it.
  *
@@ -849,6 +1266,51 @@ const WacomStylus **
 libwacom_get_styli(const WacomDevice *device,
 		   int *num_styli);
 
+/**
+ * The capabilities of all styli of this device combined, computed when
+ * the database is loaded. Devices with the same styli share a summary.
+ *
+ * @param device The tablet to query
+ * @return The summary, owned by the database. A device without styli
+ * has a summary with num_styli set to zero.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+const WacomStylusSummary *
+libwacom_get_stylus_summary(const WacomDevice *device);
+
+/**
+ * Fill in a descriptor with everything but the strings of this device in
+ * one call, e.g. for a language binding or to send it to another
+ * process.
+ *
+ * The caller passes the size of its WacomDeviceDescriptor. A smaller
+ * descriptor, compiled against an older libwacom, is filled in up to
+ * that size. A larger one, compiled against a newer libwacom, is filled
+ * in up to the size this library knows, the rest is zeroed. Either way,
+ * the descriptor's version and size say what was filled in.
+ *
+ * @code
+ * WacomDeviceDescriptor descriptor;
+ *
+ * libwacom_device_get_descriptor(device, &descriptor, sizeof(descriptor));
+ * @endcode
+ *
+ * @param device The tablet to describe
+ * @param[out] descriptor The descriptor to fill in
+ * @param size The size of the descriptor in bytes, at least large enough
+ * for its version and size fields
+ * @return zero on success or -1 if the size is too small
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_device_get_descriptor(const WacomDevice *device,
+			       WacomDeviceDescriptor *descriptor,
+			       size_t size);
+
 /**
  * @param device The tablet to query
  * @return non-zero if the device has a touch ring or zero otherwise
@@ -977,6 +1439,23 @@ int
 libwacom_get_button_led_group(const WacomDevice *device,
 			      char button);
 
+/**
+ * The status LED group of every button at once, see
+ * libwacom_get_button_led_group().
+ *
+ * @param device The tablet to query
+ * @param[out] num_buttons Set to the number of buttons, may be NULL
+ * @return an array of status LED group ids indexed by button - 'A', with
+ * one entry per button. An entry is -1 if no LED is available for that
+ * button. The array is owned by the device.
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+const int *
+libwacom_get_button_led_groups(const WacomDevice *device,
+			       int *num_buttons);
+
 /**
  * @param device The tablet to query
  * @return non-zero if the device is built into the screen (ie a screen tablet)
@@ -1058,6 +1537,161 @@ WacomModeSwitch
 libwacom_get_button_modeswitch_mode(const WacomDevice *device,
 				    char button);
 
+/**
+ * The reverse of libwacom_get_button_evdev_code(): looks up the button
+ * that sends the given evdev code. If multiple buttons send the same
+ * code, the first one is returned.
+ *
+ * @param device The tablet to query
+ * @param evdev_code The evdev code of an EV_KEY event, e.g. BTN_0
+ * @return The ID of the button between 'A' and 'Z', or 0 if no button
+ * sends this code.
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+char
+libwacom_get_button_for_evdev_code(const WacomDevice *device,
+				   unsigned int evdev_code);
+
+/**
+ * Looks up the key that sends the given evdev event. Keys are numbered
+ * from zero, see libwacom_get_num_keys().
+ *
+ * @param device The tablet to query
+ * @param type The evdev event type, EV_KEY or EV_SW
+ * @param code The evdev event code, e.g. KEY_CONTROLPANEL
+ * @return The index of the key or -1 if no key sends this event.
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_get_key_for_code(const WacomDevice *device,
+			  unsigned int type,
+			  unsigned int code);
+
+/**
+ * Create a tracker for the modes of the given device's rings, strips and
+ * dials. Each of these features with mode switch buttons is a mode
+ * group, numbered from zero in the order Ring, Ring2, Touchstrip,
+ * Touchstrip2, Dial, Dial2, skipping those without mode switch buttons.
+ * All groups start in mode zero.
+ *
+ * The tracker is built once from libwacom_get_button_flag(),
+ * libwacom_get_button_modeswitch_mode(), libwacom_get_button_led_group()
+ * and the number of modes of each feature, updating it on a button press
+ * involves neither allocations nor lookups.
+ *
+ * @param device The tablet to track the modes of, it may be destroyed
+ * once the tracker is created
+ * @return A new tracker, free with libwacom_pad_mode_tracker_destroy()
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+WacomPadModeTracker *
+libwacom_pad_mode_tracker_new(const WacomDevice *device);
+
+/**
+ * @param tracker The tracker to free, may be NULL
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+void
+libwacom_pad_mode_tracker_destroy(WacomPadModeTracker *tracker);
+
+/**
+ * Process a button press. If the button is a mode switch button, the
+ * mode of its group is updated, see libwacom_get_button_modeswitch_mode().
+ * A button that switches more than one feature only updates the first
+ * group, like libwacom_get_button_led_group() only returns the first
+ * LED.
+ *
+ * @param tracker The tracker
+ * @param button The ID of the pressed button, between 'A' and 'Z'
+ * @param[out] mode Set to the new mode of the group, may be NULL
+ * @return The mode group of the button, or -1 if the button does not
+ * switch modes. The tracker is unchanged in that case.
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_pad_mode_tracker_button_pressed(WacomPadModeTracker *tracker,
+					 char button,
+					 int *mode);
+
+/**
+ * @param tracker The tracker
+ * @return The number of mode groups
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_pad_mode_tracker_get_num_groups(const WacomPadModeTracker *tracker);
+
+/**
+ * @param tracker The tracker
+ * @param group The mode group, from zero
+ * @return The current mode of the group, or -1 if the group is invalid
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_pad_mode_tracker_get_mode(const WacomPadModeTracker *tracker,
+				   int group);
+
+/**
+ * Set the mode of a group, e.g. to the mode the status LEDs show when
+ * the tracker is created.
+ *
+ * @param tracker The tracker
+ * @param group The mode group, from zero
+ * @param mode The new mode, from zero
+ * @return non-zero if the mode was set, zero if the group or the mode is
+ * invalid
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_pad_mode_tracker_set_mode(WacomPadModeTracker *tracker,
+				   int group,
+				   int mode);
+
+/**
+ * @param tracker The tracker
+ * @param group The mode group, from zero
+ * @return The number of modes of the group, or -1 if the group is invalid
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_pad_mode_tracker_get_num_modes(const WacomPadModeTracker *tracker,
+					int group);
+
+/**
+ * The status LED group of a mode group, see libwacom_get_status_leds().
+ * Within the LED group, the LED with the index of the current mode is
+ * the one to light.
+ *
+ * @param tracker The tracker
+ * @param group The mode group, from zero
+ * @return The index of the status LED group, or -1 if the group has no
+ * status LEDs or is invalid
+ *
+ * @ingroup devices
+ * @since 2.20
+ */
+int
+libwacom_pad_mode_tracker_get_led_group(const WacomPadModeTracker *tracker,
+					int group);
+
 /**
  * Get the WacomStylus for the given tool ID.
  *
@@ -1076,6 +1710,133 @@ const WacomStylus *
 libwacom_stylus_get_for_id(const WacomDeviceDatabase *db,
 			   int id);
 
+/**
+ * Get the WacomStylus for the given vendor and tool ID. Unlike
+ * libwacom_stylus_get_for_id(), this works for the styli of every
+ * vendor. The generic styli are found for any vendor ID.
+ *
+ * @param db A Tablet and Stylus database.
+ * @param vendor_id The vendor ID of the stylus, e.g. 0x56a
+ * @param tool_id The tool ID of the stylus
+ * @return A WacomStylus representing the stylus or NULL if the database
+ * has no such stylus. Do not free.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+const WacomStylus *
+libwacom_stylus_get_for_vid_and_id(const WacomDeviceDatabase *db,
+				   int vendor_id,
+				   int tool_id);
+
+/**
+ * Export the styli of the database, or those of one device, into
+ * caller-provided buffers in one call, e.g. to mirror them into shared
+ * memory. The records are in the order of libwacom_list_styli_from_database()
+ * or libwacom_get_styli(), respectively.
+ *
+ * The styli paired with a record are the indices in table->paired from
+ * paired_first to paired_first + num_paired - 1. When exporting the
+ * styli of a device, paired styli the device does not support are left
+ * out.
+ *
+ * Call this once with zero capacities to get the required sizes, then
+ * again with buffers of at least that size:
+ *
+ * @code
+ * WacomStylusTable table = {0};
+ *
+ * libwacom_database_export_styli(db, NULL, &table);
+ * table.records = calloc(table.num_records, sizeof(*table.records));
+ * table.paired = calloc(table.num_paired, sizeof(*table.paired));
+ * table.strings = calloc(table.strings_size, 1);
+ * libwacom_database_export_styli(db, NULL, &table);
+ * @endcode
+ *
+ * @param db A Tablet and Stylus database.
+ * @param device A device from this database or NULL for all styli
+ * @param[in,out] table The buffers and their capacities, the capacities
+ * are replaced with the required sizes
+ * @return zero on success or -1 if a buffer is too small, in which case
+ * none are written to
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+int
+libwacom_database_export_styli(const WacomDeviceDatabase *db,
+			       const WacomDevice *device,
+			       WacomStylusTable *table);
+
+/**
+ * Create a resolver for the styli of the given device. A resolver looks
+ * up the WacomStylus for a tool ID like
+ * libwacom_stylus_get_for_vid_and_id() and checks in constant time
+ * whether that stylus is supported by the device without walking the
+ * list returned by libwacom_get_styli(). It is meant to be created once
+ * per device and used for every proximity event.
+ *
+ * The resolver holds a reference to the database.
+ *
+ * @param db A Tablet and Stylus database.
+ * @param device A device from this database, it may be destroyed once
+ * the resolver is created
+ * @return A new resolver, free with libwacom_stylus_resolver_destroy()
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+WacomStylusResolver *
+libwacom_stylus_resolver_new(WacomDeviceDatabase *db,
+			     const WacomDevice *device);
+
+/**
+ * Free the resolver and release its reference to the database.
+ *
+ * @param resolver The resolver to free, may be NULL
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+void
+libwacom_stylus_resolver_destroy(WacomStylusResolver *resolver);
+
+/**
+ * Get the WacomStylus for the given vendor and tool ID, e.g. the
+ * ABS_MISC value of a proximity event. As with
+ * libwacom_stylus_get_for_id(), the generic tool IDs are looked up
+ * regardless of the vendor ID.
+ *
+ * The stylus may not be supported by the resolver's device, see
+ * libwacom_stylus_resolver_is_supported().
+ *
+ * @param resolver The resolver to query
+ * @param vendor_id The vendor ID of the stylus
+ * @param tool_id The tool ID of the stylus
+ * @return The stylus or NULL if the database has none with this ID. Do
+ * not free.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+const WacomStylus *
+libwacom_stylus_resolver_lookup(const WacomStylusResolver *resolver,
+				int vendor_id,
+				int tool_id);
+
+/**
+ * @param resolver The resolver to query
+ * @param stylus A stylus from the resolver's database
+ * @return non-zero if the stylus is in the list returned by
+ * libwacom_get_styli() for the resolver's device
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+int
+libwacom_stylus_resolver_is_supported(const WacomStylusResolver *resolver,
+				      const WacomStylus *stylus);
+
 /**
  * @param stylus The stylus to query
  * @return the ID of the tool
@@ -1137,6 +1898,56 @@ const WacomStylus **
 libwacom_stylus_get_paired_styli(const WacomStylus *stylus,
 				 int *num_paired);
 
+/**
+ * Get the eraser at the other end of a pen, i.e. the tool the pen
+ * reports once it is flipped over. If the pen is paired with more than
+ * one eraser, the first one listed is returned.
+ *
+ * @param stylus The stylus to query
+ * @return The eraser paired with this stylus or NULL if the stylus is
+ * an eraser itself or has no paired eraser. Do not free.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+const WacomStylus *
+libwacom_stylus_get_paired_eraser(const WacomStylus *stylus);
+
+/**
+ * Get the pen an eraser belongs to, the reverse of
+ * libwacom_stylus_get_paired_eraser().
+ *
+ * @param stylus The stylus to query
+ * @return The pen paired with this eraser or NULL if the stylus is not
+ * an eraser or has no paired pen. Do not free.
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+const WacomStylus *
+libwacom_stylus_get_paired_pen(const WacomStylus *stylus);
+
+/**
+ * List the devices that support this stylus, i.e. those whose
+ * libwacom_get_styli() includes it.
+ *
+ * The list is built when the database is loaded and owned by the
+ * database, it must not be modified or freed. The devices are the
+ * database's own, as returned by libwacom_list_devices_from_database(),
+ * and sorted the same way.
+ *
+ * @param stylus The stylus to query
+ * @param[out] num_devices Optional return location for the number of
+ * devices, excluding the NULL terminator
+ * @return A NULL-terminated list of devices
+ *
+ * @ingroup styli
+ * @since 2.20
+ */
+WacomDevice *const *
+libwacom_stylus_list_devices(const WacomStylus *stylus,
+			     int *num_devices);
+
 /**
  * @param stylus The stylus to query
  * @return The number of buttons on the stylus
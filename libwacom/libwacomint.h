@@ -29,10 +29,13 @@
 #ifndef _LIBWACOMINT_H_
 #define _LIBWACOMINT_H_
 
+#include <gio/gio.h>
 #include <glib.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 #include "libwacom.h"
+#include "util-arena.h"
 
 #define LIBWACOM_EXPORT __attribute__ ((visibility("default")))
 
@@ -67,70 +70,136 @@ struct _WacomBuilder {
 	uint32_t product_id;
 };
 
-/* WARNING: When adding new members to this struct
- * make sure to update libwacom_copy_match() ! */
-struct _WacomMatch {
+/* Every string a database hands out lives once in its arena, as do its
+ * devices, styli and matches. Copies of its devices hold a reference so
+ * they remain valid after the database itself is gone. */
+typedef struct _WacomArena {
 	gatomicrefcount refcnt;
-	char *match;
-	char *name;
-	char *uniq;
-	WacomBusType bus;
-	uint32_t vendor_id;
-	uint32_t product_id;
+	struct arena strings;
+	GHashTable *interned; /* the strings in the arena, as a set */
+	struct arena objects;
+	struct arena details; /* device and stylus details, deprecated ids */
+	GMutex lock; /* for allocations once the database is in use */
+	gint live_devices; /* copies not yet destroyed */
+	void *image;       /* the mapped database image, see libwacom-image.c */
+	gsize image_size;
+} WacomArena;
+
+/* Allocated in the arena. Within a database, matches are equal if their
+ * fields are, the name and uniq pointers included. */
+struct _WacomMatch {
+	const char *name;  /* interned */
+	const char *uniq;  /* interned */
+	WacomArena *arena; /* for the match string */
+	char *match;       /* formatted on first use, see
+			      libwacom_match_get_match_string() */
+	uint16_t vendor_id;
+	uint16_t product_id;
+	uint8_t bus; /* WacomBusType */
 };
 
-/* Used in the device->buttons hashtable */
+/* 'A' to 'Z' */
+#define WACOM_MAX_BUTTONS 26
+
+/* Used in the device->buttons table, flags is WACOM_BUTTON_NONE for
+ * buttons the device doesn't have */
 typedef struct _WacomButton {
 	WacomButtonFlags flags;
 	int code;
 	WacomModeSwitch mode;
 } WacomButton;
 
+/* Allocated in the arena, devices with the same styli share one */
+typedef struct _WacomStyliSet {
+	WacomStylus **styli; /* sorted by id */
+	guint num_styli;
+	WacomStylusSummary summary;
+	WacomArena *arena; /* for the deprecated ids */
+	/* for libwacom_get_supported_styli(), built on first use */
+	gsize deprecated_ids_once;
+	int *deprecated_ids;
+	guint num_deprecated_ids;
+} WacomStyliSet;
+
 typedef struct _WacomKeycode {
 	unsigned int type;
 	unsigned int code;
 } WacomKeycode;
 
-/* WARNING: When adding new members to this struct
- * make sure to update libwacom_copy() and
- * libwacom_print_device_description() ! */
-struct _WacomDevice {
-	char *name;
-	char *model_name;
+/* Pad buttons send codes from BTN_MISC up to BTN_DIGI */
+#define WACOM_BUTTON_CODE_MIN 0x100
+#define WACOM_NUM_BUTTON_CODES 0x40
+
+#define WACOM_MAX_KEYCODES 32
+/* Twice the number of keys so the table is never more than half full */
+#define WACOM_KEYCODE_SLOTS 64
+
+/* The first slot to probe in the key_for_code table, the top six bits
+ * of a Fibonacci hash */
+static inline guint
+wacom_keycode_slot(unsigned int type,
+		   unsigned int code)
+{
+	return (((guint32)type << 16 | code) * 2654435761U) >> 26;
+}
+
+/* Ring, Ring2, Touchstrip, Touchstrip2, Dial, Dial2 */
+#define WACOM_MAX_STATUS_LEDS 6
+
+/* The parts of a device only needed to describe it rather than to find
+ * or compare it, kept out of line so the device itself stays small.
+ * Allocated in the arena and shared by all copies of the device. Holds
+ * no pointers, so database images share it in place. */
+typedef struct _WacomDeviceDetails {
 	int width_mm;
 	int height_mm;
-
-	WacomMatch *match; /* used match or first match by default */
-	GArray *matches;
-
+	WacomStatusLEDs status_leds[WACOM_MAX_STATUS_LEDS];
+	guint num_status_leds;
+	WacomButton buttons[WACOM_MAX_BUTTONS]; /* indexed by button - 'A' */
+	WacomKeycode keycodes[WACOM_MAX_KEYCODES];
+	size_t num_keycodes;
+	/* The reverse of the above: the button or 0, indexed by code -
+	 * WACOM_BUTTON_CODE_MIN, and an open-addressed table of keycodes
+	 * index + 1 or 0 for an empty slot */
+	char button_for_code[WACOM_NUM_BUTTON_CODES];
+	uint8_t key_for_code[WACOM_KEYCODE_SLOTS];
+	/* libwacom_get_button_led_group() for every button */
+	int button_led_groups[WACOM_MAX_BUTTONS];
+} WacomDeviceDetails;
+
+/* WARNING: When adding new members to this struct or its details
+ * make sure to update libwacom_copy() and
+ * libwacom_print_device_description() !
+ *
+ * The database's devices and everything they point to are allocated in
+ * the arena, copies share these and only own their name_override. */
+struct _WacomDevice {
+	const char *name; /* interned or name_override */
+	const char *model_name; /* interned */
+	const char *layout;     /* interned */
+	WacomMatch *match;    /* used match or first match by default */
+	WacomMatch **matches; /* NULL-terminated */
 	WacomMatch *paired;
+	const WacomStyliSet *styli;
+	WacomDeviceDetails *details;
 
+	guint num_matches;
 	WacomClass cls;
+	uint32_t features;
+	uint32_t integration_flags;
+	int num_buttons;
 	int num_strips;
 	int num_rings;
 	int num_dials;
-	uint32_t features;
-	uint32_t integration_flags;
-
 	int strips_num_modes;
 	int dial_num_modes;
 	int dial2_num_modes;
 	int ring_num_modes;
 	int ring2_num_modes;
 
-	/* for libwacom_get_supported_styli() */
-	GArray *deprecated_styli_ids; /* int */
-	/* for libwacom_get_styli() */
-	GArray *styli;       /* WacomStylus* */
-	GHashTable *buttons; /* 'A' : WacomButton */
-	WacomKeycode keycodes[32];
-	size_t num_keycodes;
-
-	GArray *status_leds;
-
-	char *layout;
-
-	gatomicrefcount refcnt; /* for the db hashtable */
+	gatomicrefcount refcnt; /* copies only */
+	char *name_override;    /* the fallback device's name, if changed */
+	WacomArena *arena;      /* NULL unless this is a copy */
 };
 
 typedef struct _WacomStylusId {
@@ -138,31 +207,177 @@ typedef struct _WacomStylusId {
 	unsigned int tool_id;
 } WacomStylusId;
 
+/* The parts of a stylus only needed while loading the database or for
+ * the deprecated API, allocated in the arena */
+typedef struct _WacomStylusDetails {
+	const char *group; /* interned */
+	WacomStylusId *paired_stylus_ids; /* resolved into paired_styli */
+	guint num_paired_stylus_ids;
+	gboolean paired_from_alias; /* the ids are those of AliasOf */
+	WacomDevice **devices; /* NULL-terminated, sorted like
+				  libwacom_list_devices_from_database() */
+	guint num_devices;
+	WacomArena *arena; /* for the deprecated ids */
+	/* for libwacom_stylus_get_paired_ids(), built on first use */
+	gsize deprecated_paired_ids_once;
+	int *deprecated_paired_ids;
+	guint num_deprecated_paired_ids;
+} WacomStylusDetails;
+
+/* Allocated in the arena */
 struct _WacomStylus {
-	gatomicrefcount refcnt;
 	WacomStylusId id;
-	char *name;
-	char *group;
+	const char *name; /* interned */
+	WacomStylus **paired_styli;
+	WacomStylus *paired_eraser; /* for a pen, from paired_styli */
+	WacomStylus *paired_pen;    /* for an eraser, from paired_styli */
+	WacomStylusDetails *details;
+	guint index; /* unique in the database, see WacomStylusResolver */
+	guint num_paired_styli;
 	int num_buttons;
 	gboolean has_eraser;
 	gboolean is_generic_stylus;
-	GArray *paired_styli;          /* [WacomStylus*, ...] */
-	GArray *deprecated_paired_ids; /* [int, ...] */
-	GArray *paired_stylus_ids;     /* [WacomStylusId, ...], NULL once parsing is
-					  complete */
-	WacomEraserType eraser_type;
 	gboolean has_lens;
 	gboolean has_wheel;
+	WacomEraserType eraser_type;
 	WacomStylusType type;
 	WacomAxisTypeFlags axes;
 };
 
+/* The fallbacks of libwacom_stylus_get_num_buttons() and
+ * libwacom_stylus_get_type() for styli that don't define them */
+static inline int
+stylus_num_buttons_or_default(const WacomStylus *stylus)
+{
+	return stylus->num_buttons == -1 ? 2 : stylus->num_buttons;
+}
+
+static inline WacomStylusType
+stylus_type_or_default(const WacomStylus *stylus)
+{
+	return stylus->type == WSTYLUS_UNKNOWN ? WSTYLUS_GENERAL : stylus->type;
+}
+
+/* See libwacom_stylus_resolver_new() */
+struct _WacomStylusResolver {
+	WacomDeviceDatabase *db; /* a reference, owns the styli */
+	guint32 *supported;      /* bitset by WacomStylus index */
+	guint num_styli;         /* the bits in supported */
+};
+
+/* Ring, Ring2, Touchstrip, Touchstrip2, Dial, Dial2 */
+#define WACOM_MAX_MODE_GROUPS 6
+
+/* See libwacom_pad_mode_tracker_new() */
+struct _WacomPadModeTracker {
+	int8_t button_group[WACOM_MAX_BUTTONS]; /* by button - 'A', -1 for none */
+	int button_mode[WACOM_MAX_BUTTONS];     /* mode or WACOM_MODE_SWITCH_NEXT */
+	guint num_groups;
+	struct {
+		int num_modes; /* at least 1 */
+		int led_group; /* -1 without a status LED */
+		int mode;
+	} groups[WACOM_MAX_MODE_GROUPS];
+};
+
+/* Device discovery goes through this interface so the test suite can run
+ * it against a fake sysfs tree. Nodes are refcounted by the backend,
+ * strings returned are owned by the node. */
+typedef struct _WacomUdevBackend WacomUdevBackend;
+struct _WacomUdevBackend {
+	/* Returns a new node for the device node path or NULL */
+	void *(*lookup)(const WacomUdevBackend *backend,
+			const char *devnode);
+	/* Returns a new node for the parent or NULL */
+	void *(*get_parent)(void *node);
+	const char *(*get_property)(void *node,
+				    const char *key);
+	const char *(*get_subsystem)(void *node);
+	const char *(*get_sysname)(void *node);
+	void (*unref)(void *node);
+	const char *sysfs_root; /* "/sys" */
+};
+
+extern const WacomUdevBackend udev_backend_gudev;
+
+/* Firmware strings often carry a version that changes with firmware
+ * updates. A rule from a .uniq file applies to a uniq starting with
+ * prefix that splits into at least min_fields fields at separator, and
+ * removes its last strip_fields fields. */
+typedef struct _WacomUniqRule {
+	char *prefix; /* NULL matches any uniq */
+	char separator;
+	guint min_fields;
+	guint strip_fields;
+} WacomUniqRule;
+
+/* The styli of one vendor, see libwacom_stylus_get_for_vid_and_id() */
+typedef struct _WacomVendorStyli {
+	unsigned int vid;
+	guint num_styli;
+	const WacomStylus **styli; /* sorted by tool id, in the stylus_table */
+} WacomVendorStyli;
+
 struct _WacomDeviceDatabase {
 	gatomicrefcount refcnt;
-	GHashTable *device_ht; /* key = DeviceMatch (str), value = WacomDeviceData * */
+	WacomArena *arena;
+	GHashTable *device_ht; /* key = WacomMatch *, value = WacomDevice * */
 	GHashTable *stylus_ht; /* key = WacomStylusId, value = WacomStylus * */
+	GArray *uniq_rules;    /* WacomUniqRule, the first matching rule applies */
+	const WacomStylus **stylus_table; /* all styli by vendor and tool id */
+	WacomVendorStyli *vendors;        /* sorted by vid */
+	guint num_vendors;
+	GHashTable *styli_sets; /* key = GBytes of the styli, value = WacomStyliSet *,
+				   only while parsing */
+	const WacomUdevBackend *udev;
+	GMutex path_cache_lock;
+	GHashTable *path_cache; /* key = devnode, value = WacomPathCacheEntry *,
+				   NULL unless enabled */
+	GHashTable *path_requests; /* key = "fallback:devnode",
+				      value = WacomPathRequest *, in flight */
 };
 
+/* Cheap to obtain without udev: a node reused for a different device
+ * gets a new sysfs directory and thus a new inode */
+typedef struct _WacomNodeIdentity {
+	dev_t rdev;
+	ino_t node_ino;
+	ino_t sysfs_ino;
+} WacomNodeIdentity;
+
+typedef struct _WacomPathCacheEntry {
+	WacomNodeIdentity identity;
+	WacomFallbackFlags fallback;
+	WacomDevice *device;
+} WacomPathCacheEntry;
+
+/* A libwacom_new_from_path_async() lookup shared by all concurrent
+ * requests for the same path */
+typedef struct _WacomPathRequest {
+	WacomDeviceDatabase *db;
+	char *key;
+	char *path;
+	WacomFallbackFlags fallback;
+	GPtrArray *waiters;        /* GTask *, owned */
+	GCancellable *cancellable; /* cancelled when all waiters are */
+} WacomPathRequest;
+
+/* Everything device discovery needs from udev, collected in a single walk
+ * up the parent chain of the event node */
+typedef struct _WacomDeviceInfo {
+	char *devnode;
+	char *sysname;          /* e.g. "event3" */
+	char *name;             /* NAME, quotes stripped */
+	char *uniq;             /* UNIQ, quotes stripped, not normalized */
+	char *product;          /* PRODUCT, "bus/vid/pid/version" */
+	char *subsystem;        /* first subsystem that isn't input or hid */
+	gboolean is_uinput;     /* UINPUT_DEVICE set on any ancestor */
+	char *uinput_subsystem; /* UINPUT_SUBSYSTEM of that ancestor */
+	gboolean is_tablet_or_touchpad; /* on the node or its parent */
+	gboolean is_touchpad;           /* on the node itself */
+	WacomIntegrationFlags integration_flags;
+} WacomDeviceInfo;
+
 struct _WacomError {
 	enum WacomErrorCode code;
 	char *msg;
@@ -172,14 +387,6 @@ WacomDevice *
 libwacom_ref(WacomDevice *device);
 WacomDevice *
 libwacom_unref(WacomDevice *device);
-WacomStylus *
-libwacom_stylus_ref(WacomStylus *stylus);
-WacomStylus *
-libwacom_stylus_unref(WacomStylus *stylus);
-WacomMatch *
-libwacom_match_ref(WacomMatch *match);
-WacomMatch *
-libwacom_match_unref(WacomMatch *match);
 
 void
 libwacom_error_set(WacomError *error,
@@ -187,17 +394,64 @@ libwacom_error_set(WacomError *error,
 		   const char *msg,
 		   ...);
 void
-libwacom_add_match(WacomDevice *device,
-		   WacomMatch *newmatch);
-void
 libwacom_set_default_match(WacomDevice *device,
-			   WacomMatch *newmatch);
+			   const WacomMatch *match);
+void
+libwacom_setup_button_led_groups(WacomDevice *device);
 WacomMatch *
-libwacom_match_new(const char *name,
+libwacom_match_new(WacomArena *arena,
+		   const char *name,
 		   const char *uniq,
 		   WacomBusType bus,
 		   int vendor_id,
 		   int product_id);
+guint
+libwacom_match_hash(gconstpointer data);
+gboolean
+libwacom_match_equal(gconstpointer a,
+		     gconstpointer b);
+
+WacomDeviceDatabase *
+libwacom_database_alloc(void);
+void
+libwacom_database_build_lazy(WacomDeviceDatabase *db);
+void
+libwacom_database_build_stylus_table(WacomDeviceDatabase *db);
+
+WacomArena *
+libwacom_arena_new(void);
+WacomArena *
+libwacom_arena_ref(WacomArena *arena);
+WacomArena *
+libwacom_arena_unref(WacomArena *arena);
+const char *
+libwacom_arena_intern(WacomArena *arena,
+		      const char *str);
+const char *
+libwacom_arena_lookup(const WacomArena *arena,
+		      const char *str);
+const int *
+libwacom_styli_set_get_deprecated_ids(WacomStyliSet *set,
+				      guint *num_ids);
+const int *
+libwacom_stylus_get_deprecated_paired_ids(WacomStylus *stylus,
+					  guint *num_ids);
+
+WacomDeviceInfo *
+device_info_new_from_path(const WacomUdevBackend *backend,
+			  const char *path,
+			  WacomError *error);
+void
+device_info_free(WacomDeviceInfo *info);
+
+void
+path_cache_entry_free(WacomPathCacheEntry *entry);
+
+/* Around any access to a database's path_requests */
+void
+libwacom_path_requests_lock(void);
+void
+libwacom_path_requests_unlock(void);
 
 WacomBusType
 bus_from_str(const char *str);
@@ -210,10 +464,10 @@ make_match_string(const char *name,
 		  int vendor_id,
 		  int product_id);
 
-G_DEFINE_AUTOPTR_CLEANUP_FUNC(WacomMatch,
-			      libwacom_match_unref);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(WacomDevice,
 			      libwacom_unref);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(WacomDeviceInfo,
+			      device_info_free);
 
 #endif /* _LIBWACOMINT_H_ */
 
@@ -0,0 +1,191 @@
+/*
+ * Copyright © 2025 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* A bump allocator: memory is handed out from large blocks and only
+ * released all at once with arena_release(). Allocations are zeroed.
+ * The blocks are mapped separately so arena_protect() can make them
+ * read-only. */
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* max_align_t is C11 */
+union arena_align {
+	long double ld;
+	long long ll;
+	void *p;
+};
+
+struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+	union arena_align data[];
+};
+
+struct arena {
+	struct arena_block *blocks; /* the one in use first */
+	bool readonly;              /* after arena_protect() */
+};
+
+static inline void *
+arena_alloc_aligned(struct arena *arena,
+		    size_t size,
+		    size_t alignment)
+{
+	struct arena_block *block = arena->blocks;
+	size_t block_size, page_size;
+
+	if (arena->readonly)
+		abort();
+
+	if (block) {
+		size_t offset = (block->used + alignment - 1) & ~(alignment - 1);
+
+		if (offset + size <= block->size) {
+			block->used = offset + size;
+			return (char *)block->data + offset;
+		}
+	}
+
+	/* Whole pages, the header included */
+	page_size = sysconf(_SC_PAGESIZE);
+	block_size = sizeof(*block) + size;
+	if (block_size < ARENA_BLOCK_SIZE)
+		block_size = ARENA_BLOCK_SIZE;
+	block_size = (block_size + page_size - 1) & ~(page_size - 1);
+	block = mmap(NULL,
+		     block_size,
+		     PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS,
+		     -1,
+		     0);
+	if (block == MAP_FAILED)
+		abort();
+	block->size = block_size - sizeof(*block);
+	block->used = size;
+
+	/* An oversized allocation gets a block of its own, keep filling
+	 * the current one */
+	if (arena->blocks && block_size > ARENA_BLOCK_SIZE) {
+		block->next = arena->blocks->next;
+		arena->blocks->next = block;
+	} else {
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+
+	return block->data;
+}
+
+static inline void *
+arena_alloc(struct arena *arena,
+	    size_t size)
+{
+	return arena_alloc_aligned(arena, size, alignof(union arena_align));
+}
+
+static inline void *
+arena_memdup(struct arena *arena,
+	     const void *data,
+	     size_t size)
+{
+	void *p;
+
+	if (size == 0)
+		return NULL;
+
+	p = arena_alloc(arena, size);
+	memcpy(p, data, size);
+
+	return p;
+}
+
+static inline char *
+arena_strdup(struct arena *arena,
+	     const char *str)
+{
+	size_t len;
+	char *s;
+
+	if (!str)
+		return NULL;
+
+	len = strlen(str) + 1;
+	s = arena_alloc_aligned(arena, len, 1);
+	memcpy(s, str, len);
+
+	return s;
+}
+
+/* The memory held by the arena, used or not */
+static inline size_t
+arena_size(const struct arena *arena)
+{
+	size_t size = 0;
+
+	for (struct arena_block *block = arena->blocks; block; block = block->next)
+		size += sizeof(*block) + block->size;
+
+	return size;
+}
+
+/* Makes all memory handed out so far read-only, further allocations
+ * abort. Returns false if mprotect() failed */
+static inline bool
+arena_protect(struct arena *arena)
+{
+	arena->readonly = true;
+
+	for (struct arena_block *block = arena->blocks; block; block = block->next) {
+		if (mprotect(block, sizeof(*block) + block->size, PROT_READ) < 0)
+			return false;
+	}
+
+	return true;
+}
+
+static inline void
+arena_release(struct arena *arena)
+{
+	struct arena_block *block = arena->blocks;
+
+	while (block) {
+		struct arena_block *next = block->next;
+		munmap(block, sizeof(*block) + block->size);
+		block = next;
+	}
+	arena->blocks = NULL;
+	arena->readonly = false;
+}
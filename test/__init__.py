@@ -22,7 +22,17 @@ import ctypes
 import enum
 import itertools
 import logging
-from ctypes import c_char, c_char_p, c_int, c_uint32, c_void_p
+from ctypes import (
+    c_char,
+    c_char_p,
+    c_int,
+    c_int32,
+    c_size_t,
+    c_uint,
+    c_uint16,
+    c_uint32,
+    c_void_p,
+)
 from dataclasses import dataclass
 from pathlib import Path
 from typing import ClassVar
@@ -54,6 +64,120 @@ class _Enum:
         return self.name.removeprefix("WACOM_").removeprefix("W")
 
 
+class _StylusSummary(ctypes.Structure):
+    _fields_: ClassVar = [
+        ("num_styli", c_int),
+        ("axes_any", c_int),
+        ("axes_all", c_int),
+        ("max_buttons", c_int),
+        ("has_eraser", c_int),
+        ("has_lens", c_int),
+        ("has_wheel", c_int),
+        ("eraser_types", c_uint32),
+        ("types", c_uint32),
+    ]
+
+
+class _ButtonDescriptor(ctypes.Structure):
+    _fields_: ClassVar = [
+        ("flags", c_uint32),
+        ("code", c_uint32),
+        ("mode", c_int32),
+        ("led_group", c_int32),
+    ]
+
+
+class _KeyDescriptor(ctypes.Structure):
+    _fields_: ClassVar = [
+        ("type", c_uint32),
+        ("code", c_uint32),
+    ]
+
+
+class _MatchDescriptor(ctypes.Structure):
+    _fields_: ClassVar = [
+        ("bustype", c_uint32),
+        ("vendor_id", c_uint16),
+        ("product_id", c_uint16),
+    ]
+
+
+class _StylusIdDescriptor(ctypes.Structure):
+    _fields_: ClassVar = [
+        ("vendor_id", c_uint32),
+        ("tool_id", c_uint32),
+    ]
+
+
+class _StylusRecord(ctypes.Structure):
+    HAS_ERASER = 1 << 0
+    IS_ERASER = 1 << 1
+    HAS_LENS = 1 << 2
+    HAS_WHEEL = 1 << 3
+    IS_GENERIC = 1 << 4
+
+    _fields_: ClassVar = [
+        ("vendor_id", c_uint32),
+        ("tool_id", c_uint32),
+        ("name", c_uint32),
+        ("axes", c_uint32),
+        ("flags", c_uint32),
+        ("type", c_int32),
+        ("eraser_type", c_int32),
+        ("num_buttons", c_int32),
+        ("paired_first", c_uint32),
+        ("num_paired", c_uint32),
+    ]
+
+
+class _StylusTable(ctypes.Structure):
+    _fields_: ClassVar = [
+        ("records", ctypes.POINTER(_StylusRecord)),
+        ("num_records", c_size_t),
+        ("paired", ctypes.POINTER(c_uint32)),
+        ("num_paired", c_size_t),
+        ("strings", ctypes.POINTER(ctypes.c_char)),
+        ("strings_size", c_size_t),
+    ]
+
+
+class _DeviceDescriptor(ctypes.Structure):
+    VERSION = 1
+
+    _fields_: ClassVar = [
+        ("version", c_uint32),
+        ("size", c_uint32),
+        ("flags", c_uint32),
+        ("match", _MatchDescriptor),
+        ("paired", _MatchDescriptor),
+        ("integration_flags", c_uint32),
+        ("width_mm", c_int32),
+        ("height_mm", c_int32),
+        ("has_stylus", c_int32),
+        ("has_touch", c_int32),
+        ("has_touchswitch", c_int32),
+        ("is_reversible", c_int32),
+        ("num_rings", c_int32),
+        ("num_strips", c_int32),
+        ("num_dials", c_int32),
+        ("ring_num_modes", c_int32),
+        ("ring2_num_modes", c_int32),
+        ("strips_num_modes", c_int32),
+        ("dial_num_modes", c_int32),
+        ("dial2_num_modes", c_int32),
+        ("num_buttons", c_uint32),
+        ("buttons", _ButtonDescriptor * 26),
+        ("num_keys", c_uint32),
+        ("keys", _KeyDescriptor * 32),
+        ("num_status_leds", c_uint32),
+        ("status_leds", c_int32 * 6),
+        ("num_styli", c_uint32),
+        ("styli", _StylusIdDescriptor * 64),
+        ("num_matches", c_uint32),
+        ("matches", _MatchDescriptor * 16),
+    ]
+
+
 class GlibC:
     _lib = None
 
@@ -135,6 +259,27 @@ class LibWacom:
             return_type=c_void_p,
         ),
         _Api(name="libwacom_database_destroy", args=(c_void_p,), return_type=None),
+        _Api(
+            name="libwacom_database_export_fd",
+            args=(c_void_p, c_void_p),
+            return_type=c_int,
+        ),
+        _Api(name="libwacom_database_freeze", args=(c_void_p,), return_type=c_int),
+        _Api(
+            name="libwacom_database_new_from_fd",
+            args=(c_int, c_void_p),
+            return_type=c_void_p,
+        ),
+        _Api(
+            name="libwacom_database_get_stats",
+            args=(c_void_p,),
+            return_type=c_void_p,
+        ),
+        _Api(
+            name="libwacom_database_set_path_cache",
+            args=(c_void_p, c_int),
+            return_type=None,
+        ),
         _Api(
             name="libwacom_new_from_builder",
             args=(c_void_p, c_void_p, c_int, c_void_p),
@@ -145,6 +290,16 @@ class LibWacom:
             args=(c_void_p, c_char_p, c_int, c_void_p),
             return_type=c_void_p,
         ),
+        _Api(
+            name="libwacom_new_from_path_async",
+            args=(c_void_p, c_char_p, c_int, c_void_p, c_void_p, c_void_p),
+            return_type=None,
+        ),
+        _Api(
+            name="libwacom_new_from_path_finish",
+            args=(c_void_p, c_void_p),
+            return_type=c_void_p,
+        ),
         _Api(
             name="libwacom_new_from_usbid",
             args=(c_void_p, c_int, c_int, c_void_p),
@@ -160,6 +315,11 @@ class LibWacom:
             args=(c_void_p, c_void_p),
             return_type=ctypes.POINTER(c_void_p),
         ),
+        _Api(
+            name="libwacom_database_export_styli",
+            args=(c_void_p, c_void_p, ctypes.POINTER(_StylusTable)),
+            return_type=c_int,
+        ),
         _Api(
             name="libwacom_list_styli_from_database",
             args=(c_void_p, c_void_p),
@@ -170,6 +330,11 @@ class LibWacom:
             args=(c_int, c_void_p),
             return_type=None,
         ),
+        _Api(
+            name="libwacom_print_udev_info",
+            args=(c_int, c_char_p, c_void_p),
+            return_type=c_int,
+        ),
         _Api(name="libwacom_destroy", args=(c_void_p,), return_type=None),
         _Api(
             name="libwacom_compare", args=(c_void_p, c_void_p, c_int), return_type=c_int
@@ -207,6 +372,16 @@ class LibWacom:
             args=(c_void_p, c_void_p),
             return_type=ctypes.POINTER(c_void_p),
         ),
+        _Api(
+            name="libwacom_device_get_descriptor",
+            args=(c_void_p, c_void_p, c_size_t),
+            return_type=c_int,
+        ),
+        _Api(
+            name="libwacom_get_stylus_summary",
+            args=(c_void_p,),
+            return_type=ctypes.POINTER(_StylusSummary),
+        ),
         _Api(name="libwacom_has_ring", args=(c_void_p,), return_type=c_int),
         _Api(name="libwacom_has_ring2", args=(c_void_p,), return_type=c_int),
         _Api(name="libwacom_get_num_rings", args=(c_void_p,), return_type=c_int),
@@ -228,6 +403,11 @@ class LibWacom:
             args=(c_void_p, c_char),
             return_type=c_int,
         ),
+        _Api(
+            name="libwacom_get_button_led_groups",
+            args=(c_void_p, c_void_p),
+            return_type=ctypes.POINTER(ctypes.c_int),
+        ),
         _Api(name="libwacom_is_builtin", args=(c_void_p,), return_type=c_int),
         _Api(name="libwacom_is_reversible", args=(c_void_p,), return_type=c_int),
         _Api(
@@ -247,11 +427,82 @@ class LibWacom:
             args=(c_void_p, c_char),
             return_type=c_int,
         ),
+        _Api(
+            name="libwacom_get_button_for_evdev_code",
+            args=(c_void_p, c_uint),
+            return_type=c_char,
+        ),
+        _Api(
+            name="libwacom_get_key_for_code",
+            args=(c_void_p, c_uint, c_uint),
+            return_type=c_int,
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_new", args=(c_void_p,), return_type=c_void_p
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_destroy",
+            args=(c_void_p,),
+            return_type=None,
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_button_pressed",
+            args=(c_void_p, c_char, c_void_p),
+            return_type=c_int,
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_get_num_groups",
+            args=(c_void_p,),
+            return_type=c_int,
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_get_mode",
+            args=(c_void_p, c_int),
+            return_type=c_int,
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_set_mode",
+            args=(c_void_p, c_int, c_int),
+            return_type=c_int,
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_get_num_modes",
+            args=(c_void_p, c_int),
+            return_type=c_int,
+        ),
+        _Api(
+            name="libwacom_pad_mode_tracker_get_led_group",
+            args=(c_void_p, c_int),
+            return_type=c_int,
+        ),
         _Api(
             name="libwacom_stylus_get_for_id",
             args=(c_void_p, c_int),
             return_type=c_void_p,
         ),
+        _Api(
+            name="libwacom_stylus_get_for_vid_and_id",
+            args=(c_void_p, c_int, c_int),
+            return_type=c_void_p,
+        ),
+        _Api(
+            name="libwacom_stylus_resolver_new",
+            args=(c_void_p, c_void_p),
+            return_type=c_void_p,
+        ),
+        _Api(
+            name="libwacom_stylus_resolver_destroy", args=(c_void_p,), return_type=None
+        ),
+        _Api(
+            name="libwacom_stylus_resolver_lookup",
+            args=(c_void_p, c_int, c_int),
+            return_type=c_void_p,
+        ),
+        _Api(
+            name="libwacom_stylus_resolver_is_supported",
+            args=(c_void_p, c_void_p),
+            return_type=c_int,
+        ),
         _Api(name="libwacom_stylus_get_id", args=(c_void_p,), return_type=c_int),
         _Api(name="libwacom_stylus_get_vendor_id", args=(c_void_p,), return_type=c_int),
         _Api(name="libwacom_stylus_get_name", args=(c_void_p,), return_type=c_char_p),
@@ -277,6 +528,21 @@ class LibWacom:
             args=(c_void_p, c_void_p),
             return_type=ctypes.POINTER(c_void_p),
         ),
+        _Api(
+            name="libwacom_stylus_get_paired_eraser",
+            args=(c_void_p,),
+            return_type=c_void_p,
+        ),
+        _Api(
+            name="libwacom_stylus_get_paired_pen",
+            args=(c_void_p,),
+            return_type=c_void_p,
+        ),
+        _Api(
+            name="libwacom_stylus_list_devices",
+            args=(c_void_p, c_void_p),
+            return_type=ctypes.POINTER(c_void_p),
+        ),
         _Api(
             name="libwacom_print_stylus_description",
             args=(c_int, c_void_p),
@@ -333,6 +599,7 @@ class LibWacom:
         _Enum(name="WERROR_BAD_ACCESS", value=4),
         _Enum(name="WERROR_UNKNOWN_MODEL", value=5),
         _Enum(name="WERROR_BUG_CALLER", value=6),
+        _Enum(name="WERROR_CANCELLED", value=7),
         _Enum(name="WBUSTYPE_UNKNOWN", value=0),
         _Enum(name="WBUSTYPE_USB", value=1),
         _Enum(name="WBUSTYPE_SERIAL", value=2),
@@ -599,10 +866,15 @@ class WacomStylus:
             allowlist = ["stylus"]
             if any(api.basename.startswith(n) for n in allowlist):
                 denylist = [
+                    "stylus_get_for_vid_and_id",
                     "stylus_get_paired_styli",
+                    "stylus_get_paired_eraser",
+                    "stylus_get_paired_pen",
+                    "stylus_list_devices",
                     "stylus_is_eraser",
                     "stylus_has_lens",
                     "stylus_has_wheel",
+                    "stylus_resolver",
                 ]
                 if all(not api.basename.startswith(n) for n in denylist):
                     func = getattr(lib, api.basename)
@@ -666,6 +938,18 @@ class WacomStylus:
         GlibC.instance().free(paired)
         return styli
 
+    @property
+    def paired_eraser(self) -> "WacomStylus | None":
+        lib = LibWacom.instance()
+        eraser = lib.stylus_get_paired_eraser(self.stylus)
+        return WacomStylus(eraser) if eraser else None
+
+    @property
+    def paired_pen(self) -> "WacomStylus | None":
+        lib = LibWacom.instance()
+        pen = lib.stylus_get_paired_pen(self.stylus)
+        return WacomStylus(pen) if pen else None
+
 
 class WacomStatusLed(enum.IntEnum):
     UNAVAILABLE = -1
@@ -755,6 +1039,20 @@ class WacomDevice:
             for m in itertools.takewhile(lambda ptr: ptr is not None, matches)
         ]
 
+    @property
+    def descriptor(self) -> _DeviceDescriptor:
+        lib = LibWacom.instance()
+        descriptor = _DeviceDescriptor()
+        rc = lib.device_get_descriptor(
+            self.device, ctypes.byref(descriptor), ctypes.sizeof(descriptor)
+        )
+        assert rc == 0
+        return descriptor
+
+    @property
+    def stylus_summary(self) -> _StylusSummary:
+        return self.get_stylus_summary().contents
+
     def get_styli(self) -> list[WacomStylus]:
         lib = LibWacom.instance()
         styli = lib.get_styli(self.device, None)
@@ -871,6 +1169,14 @@ class WacomDevice:
     def button_evdev_code(self, button: str) -> int:
         return self.get_button_evdev_code(button.encode("utf-8"))
 
+    def button_for_evdev_code(self, code: int) -> str | None:
+        button = self.get_button_for_evdev_code(code)
+        return button.decode("utf-8") if button != b"\x00" else None
+
+    def key_for_code(self, type: int, code: int) -> int | None:
+        key = self.get_key_for_code(type, code)
+        return key if key >= 0 else None
+
     def button_modeswitch_mode(self, button: str) -> ModeSwitch:
         mode = self.get_button_modeswitch_mode(button.encode("utf-8"))
         return WacomDevice.ModeSwitch(mode)
@@ -878,6 +1184,13 @@ class WacomDevice:
     def button_led_group(self, button: str) -> list[ButtonFlags]:
         return self.get_button_led_group(button.encode("utf-8"))
 
+    @property
+    def button_led_groups(self) -> list[int]:
+        nbuttons = c_int()
+        groups = self.get_button_led_groups(ctypes.byref(nbuttons))
+
+        return groups[: nbuttons.value]
+
     @property
     def status_leds(self) -> list["WacomStatusLed"]:
         nleds = c_int()
@@ -951,6 +1264,33 @@ class WacomDatabase:
         GlibC.instance().free(devices)
         return devs
 
+    def stylus_for_vid_and_id(self, vid: int, tool_id: int) -> WacomStylus | None:
+        lib = LibWacom.instance()
+        stylus = lib.stylus_get_for_vid_and_id(self.db, vid, tool_id)
+        return WacomStylus(stylus) if stylus else None
+
+    def export_styli(
+        self, device: WacomDevice | None = None
+    ) -> tuple[list[_StylusRecord], list[int], bytes]:
+        """
+        Returns the records, the paired indices and the string table
+        """
+        lib = LibWacom.instance()
+        dev = device.device if device else None
+        table = _StylusTable()
+        rc = lib.database_export_styli(self.db, dev, ctypes.byref(table))
+        assert rc == -1 or table.num_records == 0
+
+        records = (_StylusRecord * table.num_records)()
+        paired = (c_uint32 * table.num_paired)()
+        strings = ctypes.create_string_buffer(table.strings_size)
+        table.records = records
+        table.paired = paired
+        table.strings = strings
+        rc = lib.database_export_styli(self.db, dev, ctypes.byref(table))
+        assert rc == 0
+        return list(records), list(paired), strings.raw
+
     def list_styli(self) -> list[WacomStylus]:
         styli = self.libwacom_list_styli_from_database(self.db, 0)
         result = [
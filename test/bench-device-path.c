@@ -0,0 +1,214 @@
+/*
+ * Copyright © 2025 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Benchmarks libwacom_new_from_path() against a fake sysfs tree, see
+ * fake-sysfs.h. Run with meson test --benchmark or directly, see --help
+ * for the node counts.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fake-sysfs.h"
+#include "libwacom.h"
+
+static int tablets = 4;
+static int pads = 4;
+static int touch = 4;
+static int keyboards = 16;
+static int mice = 16;
+static int uinput = 4;
+static int iterations = 50;
+
+/* clang-format off */
+static GOptionEntry opts[] = {
+	{ "tablets", 0, 0, G_OPTION_ARG_INT, &tablets, "Number of tablet pen nodes", NULL },
+	{ "pads", 0, 0, G_OPTION_ARG_INT, &pads, "Number of tablet pad nodes", NULL },
+	{ "touch", 0, 0, G_OPTION_ARG_INT, &touch, "Number of tablet touch nodes", NULL },
+	{ "keyboards", 0, 0, G_OPTION_ARG_INT, &keyboards, "Number of keyboard nodes", NULL },
+	{ "mice", 0, 0, G_OPTION_ARG_INT, &mice, "Number of mouse nodes", NULL },
+	{ "uinput", 0, 0, G_OPTION_ARG_INT, &uinput, "Number of uinput tablet nodes", NULL },
+	{ "iterations", 0, 0, G_OPTION_ARG_INT, &iterations, "Number of iterations", NULL },
+	{ .long_name = NULL }
+};
+/* clang-format on */
+
+static WacomDeviceDatabase *
+load_database(void)
+{
+	WacomDeviceDatabase *db;
+	const char *datadir;
+
+	datadir = getenv("LIBWACOM_DATA_DIR");
+	if (!datadir)
+		datadir = TOPSRCDIR "/data";
+
+	db = libwacom_database_new_for_path(datadir);
+	if (!db)
+		fprintf(stderr, "Failed to load data from %s\n", datadir);
+
+	return db;
+}
+
+static GPtrArray *
+list_devnodes(const char *devinput)
+{
+	GPtrArray *devnodes = g_ptr_array_new_with_free_func(g_free);
+	const char *name;
+	GDir *dir;
+
+	dir = g_dir_open(devinput, 0, NULL);
+	if (!dir)
+		return devnodes;
+
+	while ((name = g_dir_read_name(dir)))
+		g_ptr_array_add(devnodes, g_build_filename(devinput, name, NULL));
+	g_dir_close(dir);
+
+	return devnodes;
+}
+
+static void
+bench_per_node(WacomDeviceDatabase *db,
+	       GPtrArray *devnodes)
+{
+	gint64 tablet_time = 0, other_time = 0;
+	unsigned int ntablets = 0, nothers = 0;
+
+	for (guint i = 0; i < devnodes->len; i++) {
+		const char *devnode = g_ptr_array_index(devnodes, i);
+		gboolean is_tablet = FALSE;
+		gint64 start = g_get_monotonic_time();
+
+		for (int n = 0; n < iterations; n++) {
+			WacomDevice *device =
+				libwacom_new_from_path(db, devnode, WFALLBACK_NONE, NULL);
+			if (device) {
+				is_tablet = TRUE;
+				libwacom_destroy(device);
+			}
+		}
+
+		if (is_tablet) {
+			tablet_time += g_get_monotonic_time() - start;
+			ntablets++;
+		} else {
+			other_time += g_get_monotonic_time() - start;
+			nothers++;
+		}
+	}
+
+	printf("per-node resolution, tablet:       %8.1f us (%u nodes)\n",
+	       ntablets ? (double)tablet_time / (ntablets * iterations) : 0.0,
+	       ntablets);
+	printf("per-node resolution, other device: %8.1f us (%u nodes)\n",
+	       nothers ? (double)other_time / (nothers * iterations) : 0.0,
+	       nothers);
+}
+
+static void
+bench_enumeration(WacomDeviceDatabase *db,
+		  const char *devinput)
+{
+	gint64 start = g_get_monotonic_time();
+	unsigned int found = 0;
+
+	/* What list-local-devices and most callers do at startup */
+	for (int n = 0; n < iterations; n++) {
+		g_autoptr(GPtrArray) devnodes = list_devnodes(devinput);
+
+		for (guint i = 0; i < devnodes->len; i++) {
+			const char *devnode = g_ptr_array_index(devnodes, i);
+			WacomDevice *device =
+				libwacom_new_from_path(db, devnode, WFALLBACK_NONE, NULL);
+			if (device) {
+				found++;
+				libwacom_destroy(device);
+			}
+		}
+	}
+
+	printf("full enumeration:                  %8.1f us (%u tablet nodes)\n",
+	       (double)(g_get_monotonic_time() - start) / iterations,
+	       found / iterations);
+}
+
+int
+main(int argc,
+     char **argv)
+{
+	g_autoptr(GOptionContext) context = g_option_context_new(NULL);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devnodes = NULL;
+	struct fake_sysfs *sysfs;
+	WacomDeviceDatabase *db;
+
+	g_option_context_add_main_entries(context, opts, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	if (tablets < 0 || pads < 0 || touch < 0 || keyboards < 0 || mice < 0 ||
+	    uinput < 0 || iterations <= 0) {
+		fprintf(stderr, "Invalid node count or iterations\n");
+		return EXIT_FAILURE;
+	}
+
+	db = load_database();
+	if (!db)
+		return EXIT_FAILURE;
+
+	sysfs = fake_sysfs_new();
+	fake_sysfs_populate(sysfs,
+			    &(struct fake_sysfs_config){
+				    .tablets = tablets,
+				    .pads = pads,
+				    .touch = touch,
+				    .keyboards = keyboards,
+				    .mice = mice,
+				    .uinput = uinput,
+			    });
+	db->udev = fake_sysfs_get_backend(sysfs);
+
+	devnodes = list_devnodes(fake_sysfs_get_devinput_dir(sysfs));
+	printf("%u event nodes, %d iterations\n", devnodes->len, iterations);
+
+	bench_per_node(db, devnodes);
+	bench_enumeration(db, fake_sysfs_get_devinput_dir(sysfs));
+
+	printf("with path cache:\n");
+	libwacom_database_set_path_cache(db, TRUE);
+	bench_per_node(db, devnodes);
+	bench_enumeration(db, fake_sysfs_get_devinput_dir(sysfs));
+
+	libwacom_database_destroy(db);
+	fake_sysfs_destroy(sysfs);
+
+	return EXIT_SUCCESS;
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
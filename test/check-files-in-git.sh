@@ -17,7 +17,7 @@ if ! git ls-files >& /dev/null; then
 fi
 
 pushd "$top_srcdir" > /dev/null
-for file in data/*.tablet data/*.stylus data/layouts/*.svg; do
+for file in data/*.tablet data/*.stylus data/*.uniq data/layouts/*.svg; do
     git ls-files --error-unmatch "$file" &> /dev/null || (
         echo "ERROR: File $file is not in git" && test);
     rc="$(($rc + $?))";
@@ -0,0 +1,557 @@
+/*
+ * Copyright © 2025 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fake-sysfs.h"
+#include "linux/input-event-codes.h"
+
+struct fake_sysfs {
+	WacomUdevBackend backend; /* must be first */
+	char *root;
+	char *sysfs_root;
+	char *devinput_dir;
+	char *graveyard;
+	GHashTable *devices; /* devnode -> struct fake_entry */
+	GArray *free_ids;    /* of removed devices, for reuse */
+	unsigned int next_id;
+	unsigned int nremoved;
+	int lookups; /* atomic, lookups may run in a worker thread */
+	GMutex gate_lock;
+	GCond gate_cond;
+	bool gate_closed;
+};
+
+/* What to remove again for each device */
+struct fake_entry {
+	unsigned int id;
+	char *topdir;
+	char *class_link;
+	char *devnode;
+};
+
+struct fake_node {
+	int refcount;
+	char *syspath;
+	char *sysname;
+	GHashTable *properties;
+};
+
+static void
+fake_entry_free(struct fake_entry *entry)
+{
+	g_free(entry->topdir);
+	g_free(entry->class_link);
+	g_free(entry->devnode);
+	g_free(entry);
+}
+
+static void
+rm_rf(const char *path)
+{
+	GDir *dir;
+	const char *name;
+
+	if (g_file_test(path, G_FILE_TEST_IS_SYMLINK) ||
+	    !g_file_test(path, G_FILE_TEST_IS_DIR)) {
+		g_unlink(path);
+		return;
+	}
+
+	dir = g_dir_open(path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name(dir))) {
+			g_autofree char *child = g_build_filename(path, name, NULL);
+			rm_rf(child);
+		}
+		g_dir_close(dir);
+	}
+	g_rmdir(path);
+}
+
+static void
+write_file(const char *dir,
+	   const char *name,
+	   const char *contents)
+{
+	g_autofree char *path = g_build_filename(dir, name, NULL);
+	g_autoptr(GError) error = NULL;
+
+	g_file_set_contents(path, contents, -1, &error);
+	g_assert_no_error(error);
+}
+
+static char *
+make_dir(const char *parent,
+	 const char *name)
+{
+	char *path = g_build_filename(parent, name, NULL);
+
+	g_assert_cmpint(g_mkdir_with_parents(path, 0755), ==, 0);
+
+	return path;
+}
+
+static struct fake_node *
+fake_node_new(const char *syspath)
+{
+	struct fake_node *node;
+	g_autofree char *uevent = g_build_filename(syspath, "uevent", NULL);
+	g_autofree char *contents = NULL;
+	g_auto(GStrv) lines = NULL;
+
+	if (!g_file_get_contents(uevent, &contents, NULL, NULL))
+		return NULL;
+
+	node = g_new0(struct fake_node, 1);
+	node->refcount = 1;
+	node->syspath = g_strdup(syspath);
+	node->sysname = g_path_get_basename(syspath);
+	node->properties = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	lines = g_strsplit(contents, "\n", -1);
+	for (char **line = lines; *line; line++) {
+		char *eq = strchr(*line, '=');
+
+		if (!eq)
+			continue;
+
+		g_hash_table_insert(node->properties,
+				    g_strndup(*line, eq - *line),
+				    g_strdup(eq + 1));
+	}
+
+	return node;
+}
+
+static void
+fake_node_unref(void *data)
+{
+	struct fake_node *node = data;
+
+	if (--node->refcount > 0)
+		return;
+
+	g_hash_table_destroy(node->properties);
+	g_free(node->syspath);
+	g_free(node->sysname);
+	g_free(node);
+}
+
+/* Like the GUdev backend, go through all input devices and compare the
+ * device node, so the per-lookup cost scales the same way */
+static void *
+fake_lookup(const WacomUdevBackend *backend,
+	    const char *devnode)
+{
+	struct fake_sysfs *sysfs = (struct fake_sysfs *)backend;
+	g_autofree char *classdir = g_build_filename(sysfs->sysfs_root,
+						     "class/input",
+						     NULL);
+	struct fake_node *found = NULL;
+	const char *name;
+	GDir *dir;
+
+	g_atomic_int_inc(&sysfs->lookups);
+
+	g_mutex_lock(&sysfs->gate_lock);
+	while (sysfs->gate_closed)
+		g_cond_wait(&sysfs->gate_cond, &sysfs->gate_lock);
+	g_mutex_unlock(&sysfs->gate_lock);
+
+	dir = g_dir_open(classdir, 0, NULL);
+	if (!dir)
+		return NULL;
+
+	while (!found && (name = g_dir_read_name(dir))) {
+		g_autofree char *link = g_build_filename(classdir, name, NULL);
+		g_autofree char *syspath = realpath(link, NULL);
+		struct fake_node *node;
+		const char *devname;
+
+		if (!syspath)
+			continue;
+
+		node = fake_node_new(syspath);
+		if (!node)
+			continue;
+
+		devname = g_hash_table_lookup(node->properties, "DEVNAME");
+		if (devname) {
+			g_autofree char *path =
+				g_build_filename(sysfs->root, "dev", devname, NULL);
+			if (g_str_equal(path, devnode))
+				found = g_steal_pointer(&node);
+		}
+
+		if (node)
+			fake_node_unref(node);
+	}
+	g_dir_close(dir);
+
+	return found;
+}
+
+static void *
+fake_get_parent(void *data)
+{
+	struct fake_node *node = data;
+	g_autofree char *parent = g_path_get_dirname(node->syspath);
+
+	return fake_node_new(parent);
+}
+
+static const char *
+fake_get_property(void *data,
+		  const char *key)
+{
+	struct fake_node *node = data;
+
+	return g_hash_table_lookup(node->properties, key);
+}
+
+static const char *
+fake_get_subsystem(void *data)
+{
+	return fake_get_property(data, "SUBSYSTEM");
+}
+
+static const char *
+fake_get_sysname(void *data)
+{
+	struct fake_node *node = data;
+
+	return node->sysname;
+}
+
+struct fake_sysfs *
+fake_sysfs_new(void)
+{
+	struct fake_sysfs *sysfs = g_new0(struct fake_sysfs, 1);
+	g_autoptr(GError) error = NULL;
+
+	sysfs->root = g_dir_make_tmp("libwacom-sysfs-XXXXXX", &error);
+	g_assert_no_error(error);
+
+	sysfs->sysfs_root = g_build_filename(sysfs->root, "sys", NULL);
+	sysfs->devinput_dir = make_dir(sysfs->root, "dev/input");
+	sysfs->graveyard = make_dir(sysfs->root, "graveyard");
+	g_free(make_dir(sysfs->sysfs_root, "class/input"));
+	g_free(make_dir(sysfs->sysfs_root, "devices/virtual/input"));
+	g_free(make_dir(sysfs->sysfs_root, "devices/pci0000:00"));
+
+	sysfs->devices = g_hash_table_new_full(g_str_hash,
+					       g_str_equal,
+					       NULL,
+					       (GDestroyNotify)fake_entry_free);
+	sysfs->free_ids = g_array_new(FALSE, FALSE, sizeof(unsigned int));
+	g_mutex_init(&sysfs->gate_lock);
+	g_cond_init(&sysfs->gate_cond);
+
+	sysfs->backend.lookup = fake_lookup;
+	sysfs->backend.get_parent = fake_get_parent;
+	sysfs->backend.get_property = fake_get_property;
+	sysfs->backend.get_subsystem = fake_get_subsystem;
+	sysfs->backend.get_sysname = fake_get_sysname;
+	sysfs->backend.unref = fake_node_unref;
+	sysfs->backend.sysfs_root = sysfs->sysfs_root;
+
+	return sysfs;
+}
+
+void
+fake_sysfs_destroy(struct fake_sysfs *sysfs)
+{
+	if (!sysfs)
+		return;
+
+	rm_rf(sysfs->root);
+	g_hash_table_destroy(sysfs->devices);
+	g_array_unref(sysfs->free_ids);
+	g_mutex_clear(&sysfs->gate_lock);
+	g_cond_clear(&sysfs->gate_cond);
+	g_free(sysfs->root);
+	g_free(sysfs->graveyard);
+	g_free(sysfs->sysfs_root);
+	g_free(sysfs->devinput_dir);
+	g_free(sysfs);
+}
+
+const char *
+fake_sysfs_add_device(struct fake_sysfs *sysfs,
+		      const struct fake_device *device)
+{
+	struct fake_entry *entry = g_new0(struct fake_entry, 1);
+	unsigned int id = sysfs->next_id;
+	guint free_idx = 0;
+	g_autofree char *inputdir = NULL;
+	g_autofree char *eventdir = NULL;
+	g_autofree char *inputname = NULL;
+	g_autofree char *eventname = NULL;
+	g_autoptr(GString) uevent = g_string_new(NULL);
+
+	/* Like the kernel, reuse the lowest free event node number */
+	for (guint i = 0; i < sysfs->free_ids->len; i++) {
+		unsigned int free_id = g_array_index(sysfs->free_ids, unsigned int, i);
+		if (free_id < id) {
+			id = free_id;
+			free_idx = i;
+		}
+	}
+	if (id == sysfs->next_id)
+		sysfs->next_id++;
+	else
+		g_array_remove_index_fast(sysfs->free_ids, free_idx);
+
+	entry->id = id;
+	inputname = g_strdup_printf("input%u", id);
+	eventname = g_strdup_printf("event%u", id);
+
+	if (device->uinput_subsystem) {
+		g_autofree char *virtual =
+			g_build_filename(sysfs->sysfs_root, "devices/virtual/input", NULL);
+		inputdir = make_dir(virtual, inputname);
+		entry->topdir = g_strdup(inputdir);
+	} else {
+		g_autofree char *pci =
+			g_build_filename(sysfs->sysfs_root, "devices/pci0000:00", NULL);
+		g_autofree char *busname =
+			g_strdup_printf("%s%u", device->subsystem, id);
+		g_autofree char *busdir = make_dir(pci, busname);
+		g_autofree char *uevent_bus =
+			g_strdup_printf("SUBSYSTEM=%s\n", device->subsystem);
+
+		write_file(busdir, "uevent", uevent_bus);
+		entry->topdir = g_strdup(busdir);
+
+		if (g_str_equal(device->subsystem, "usb")) {
+			g_autofree char *hidname = g_strdup_printf("%04X:%04X:%04X.%04X",
+								   device->bustype,
+								   device->vid,
+								   device->pid,
+								   id);
+			g_autofree char *hiddir = make_dir(busdir, hidname);
+
+			write_file(hiddir, "uevent", "SUBSYSTEM=hid\n");
+			inputdir = make_dir(hiddir, inputname);
+		} else {
+			inputdir = make_dir(busdir, inputname);
+		}
+	}
+
+	g_string_append(uevent, "SUBSYSTEM=input\n");
+	g_string_append_printf(uevent,
+			       "PRODUCT=%x/%x/%x/%x\n",
+			       device->bustype,
+			       device->vid,
+			       device->pid,
+			       0x100);
+	g_string_append_printf(uevent, "NAME=\"%s\"\n", device->name);
+	g_string_append_printf(uevent,
+			       "UNIQ=\"%s\"\n",
+			       device->uniq ? device->uniq : "");
+	if (device->uinput_subsystem) {
+		g_string_append(uevent, "UINPUT_DEVICE=1\n");
+		g_string_append_printf(uevent,
+				       "UINPUT_SUBSYSTEM=%s\n",
+				       device->uinput_subsystem);
+	}
+	write_file(inputdir, "uevent", uevent->str);
+	{
+		g_autofree char *props =
+			g_strdup_printf("%d\n",
+					device->direct ? 1 << INPUT_PROP_DIRECT : 0);
+		write_file(inputdir, "properties", props);
+	}
+
+	g_string_truncate(uevent, 0);
+	g_string_append(uevent, "SUBSYSTEM=input\n");
+	g_string_append_printf(uevent, "DEVNAME=input/%s\n", eventname);
+	g_string_append(uevent, "ID_INPUT=1\n");
+	if (device->tablet)
+		g_string_append(uevent, "ID_INPUT_TABLET=1\n");
+	if (device->touchpad)
+		g_string_append(uevent, "ID_INPUT_TOUCHPAD=1\n");
+	if (!device->tablet && !device->touchpad)
+		g_string_append(uevent,
+				device->bustype == FAKE_BUS_I8042 ? "ID_INPUT_KEYBOARD=1\n"
+							     : "ID_INPUT_MOUSE=1\n");
+
+	eventdir = make_dir(inputdir, eventname);
+	write_file(eventdir, "uevent", uevent->str);
+
+	/* /sys/class/input/eventN/device points to the inputN device */
+	{
+		g_autofree char *link = g_build_filename(eventdir, "device", NULL);
+		g_assert_cmpint(symlink("..", link), ==, 0);
+	}
+
+	entry->class_link =
+		g_build_filename(sysfs->sysfs_root, "class/input", eventname, NULL);
+	g_assert_cmpint(symlink(eventdir, entry->class_link), ==, 0);
+
+	entry->devnode = g_build_filename(sysfs->devinput_dir, eventname, NULL);
+	write_file(sysfs->devinput_dir, eventname, "");
+
+	g_hash_table_insert(sysfs->devices, entry->devnode, entry);
+
+	return entry->devnode;
+}
+
+void
+fake_sysfs_remove_device(struct fake_sysfs *sysfs,
+			 const char *devnode)
+{
+	struct fake_entry *entry = g_hash_table_lookup(sysfs->devices, devnode);
+	g_autofree char *grave = NULL;
+	g_autofree char *grave_devnode = NULL;
+	g_autofree char *grave_topdir = NULL;
+
+	g_assert_nonnull(entry);
+
+	/* sysfs and devtmpfs don't hand out the inode numbers of removed
+	 * nodes again right away but the filesystem the tree lives on may,
+	 * so keep the old files around until the tree is destroyed */
+	grave = g_strdup_printf("%s/%u", sysfs->graveyard, sysfs->nremoved++);
+	g_assert_cmpint(g_mkdir(grave, 0755), ==, 0);
+	grave_devnode = g_build_filename(grave, "devnode", NULL);
+	grave_topdir = g_build_filename(grave, "device", NULL);
+
+	g_assert_cmpint(g_rename(entry->devnode, grave_devnode), ==, 0);
+	g_assert_cmpint(g_rename(entry->topdir, grave_topdir), ==, 0);
+	g_unlink(entry->class_link);
+	g_array_append_val(sysfs->free_ids, entry->id);
+	g_hash_table_remove(sysfs->devices, devnode);
+}
+
+void
+fake_sysfs_populate(struct fake_sysfs *sysfs,
+		    const struct fake_sysfs_config *config)
+{
+	const struct fake_device pen = {
+		.name = FAKE_TABLET_NAME " Pen",
+		.bustype = FAKE_BUS_USB,
+		.vid = FAKE_TABLET_VID,
+		.pid = FAKE_TABLET_PID,
+		.subsystem = "usb",
+		.tablet = true,
+	};
+	const struct fake_device pad = {
+		.name = FAKE_TABLET_NAME " Pad",
+		.bustype = FAKE_BUS_USB,
+		.vid = FAKE_TABLET_VID,
+		.pid = FAKE_TABLET_PID,
+		.subsystem = "usb",
+		.tablet = true,
+	};
+	const struct fake_device touch = {
+		.name = FAKE_TABLET_NAME " Finger",
+		.bustype = FAKE_BUS_USB,
+		.vid = FAKE_TABLET_VID,
+		.pid = FAKE_TABLET_PID,
+		.subsystem = "usb",
+		.touchpad = true,
+	};
+	const struct fake_device keyboard = {
+		.name = "AT Translated Set 2 keyboard",
+		.bustype = FAKE_BUS_I8042,
+		.vid = 0x1,
+		.pid = 0x1,
+		.subsystem = "serio",
+	};
+	const struct fake_device mouse = {
+		.name = "Logitech USB Optical Mouse",
+		.bustype = FAKE_BUS_USB,
+		.vid = 0x46d,
+		.pid = 0xc077,
+		.subsystem = "usb",
+	};
+	/* evemu-style serial tablet: the PRODUCT bus is unknown to libwacom,
+	 * so the bus comes from UINPUT_SUBSYSTEM */
+	const struct fake_device uinput = {
+		.name = "Wacom Serial Penabled Pen",
+		.bustype = FAKE_BUS_RS232,
+		.vid = FAKE_TABLET_VID,
+		.pid = 0x0,
+		.uinput_subsystem = "serial",
+		.tablet = true,
+		.direct = true,
+	};
+	struct {
+		unsigned int count;
+		const struct fake_device *device;
+	} devices[] = {
+		{ config->tablets, &pen },      { config->pads, &pad },
+		{ config->touch, &touch },      { config->keyboards, &keyboard },
+		{ config->mice, &mouse },       { config->uinput, &uinput },
+	};
+	unsigned int remaining;
+
+	/* Interleave the device types, the way they'd show up on a real
+	 * system with several devices plugged in */
+	do {
+		remaining = 0;
+		for (size_t i = 0; i < G_N_ELEMENTS(devices); i++) {
+			if (devices[i].count == 0)
+				continue;
+			fake_sysfs_add_device(sysfs, devices[i].device);
+			remaining += --devices[i].count;
+		}
+	} while (remaining > 0);
+}
+
+const WacomUdevBackend *
+fake_sysfs_get_backend(struct fake_sysfs *sysfs)
+{
+	return &sysfs->backend;
+}
+
+const char *
+fake_sysfs_get_devinput_dir(struct fake_sysfs *sysfs)
+{
+	return sysfs->devinput_dir;
+}
+
+unsigned int
+fake_sysfs_get_lookup_count(struct fake_sysfs *sysfs)
+{
+	return g_atomic_int_get(&sysfs->lookups);
+}
+
+void
+fake_sysfs_set_lookups_blocked(struct fake_sysfs *sysfs,
+			       bool blocked)
+{
+	g_mutex_lock(&sysfs->gate_lock);
+	sysfs->gate_closed = blocked;
+	g_cond_broadcast(&sysfs->gate_cond);
+	g_mutex_unlock(&sysfs->gate_lock);
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2025 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "libwacomint.h"
+
+/* A fake sysfs and /dev/input tree in a temporary directory, with a
+ * WacomUdevBackend that resolves device nodes against it. The layout
+ * mimics the kernel's: /sys/class/input/eventN links to the event node
+ * below its inputN parent, which in turn sits below its bus device
+ * (or below /sys/devices/virtual/input for uinput devices). udev
+ * properties are stored in each directory's uevent file.
+ */
+struct fake_sysfs;
+
+/* From linux/input.h */
+#define FAKE_BUS_USB 0x03
+#define FAKE_BUS_I8042 0x11
+#define FAKE_BUS_RS232 0x13
+
+struct fake_device {
+	const char *name;
+	const char *uniq;
+	unsigned int bustype; /* FAKE_BUS_USB, etc. for the PRODUCT property */
+	unsigned int vid;
+	unsigned int pid;
+	/* Subsystem of the bus device, e.g. "usb" or "serio". Ignored for
+	 * uinput devices */
+	const char *subsystem;
+	/* If set, the device is created below /sys/devices/virtual with
+	 * UINPUT_DEVICE=1 and this UINPUT_SUBSYSTEM */
+	const char *uinput_subsystem;
+	bool tablet;   /* ID_INPUT_TABLET */
+	bool touchpad; /* ID_INPUT_TOUCHPAD */
+	bool direct;   /* INPUT_PROP_DIRECT */
+};
+
+struct fake_sysfs_config {
+	unsigned int tablets;   /* pen nodes of a known USB tablet */
+	unsigned int pads;      /* pad nodes of the same tablet */
+	unsigned int touch;     /* touch nodes of the same tablet */
+	unsigned int keyboards; /* unrelated serio keyboards */
+	unsigned int mice;      /* unrelated USB mice */
+	unsigned int uinput;    /* uinput serial tablets via UINPUT_SUBSYSTEM */
+};
+
+/* The tablet created by fake_sysfs_populate() */
+#define FAKE_TABLET_VID 0x056a
+#define FAKE_TABLET_PID 0x0357
+#define FAKE_TABLET_NAME "Wacom Intuos Pro M"
+
+struct fake_sysfs *
+fake_sysfs_new(void);
+
+void
+fake_sysfs_destroy(struct fake_sysfs *sysfs);
+
+/* Returns the device node path, owned by the fake sysfs. Like the
+ * kernel, the lowest free eventN is used so the device node of a removed
+ * device gets reused */
+const char *
+fake_sysfs_add_device(struct fake_sysfs *sysfs,
+		      const struct fake_device *device);
+
+/* Removes the device's sysfs directories and device node. The device
+ * node path is no longer valid afterwards */
+void
+fake_sysfs_remove_device(struct fake_sysfs *sysfs,
+			 const char *devnode);
+
+void
+fake_sysfs_populate(struct fake_sysfs *sysfs,
+		    const struct fake_sysfs_config *config);
+
+const WacomUdevBackend *
+fake_sysfs_get_backend(struct fake_sysfs *sysfs);
+
+/* The equivalent of /dev/input in the fake tree */
+const char *
+fake_sysfs_get_devinput_dir(struct fake_sysfs *sysfs);
+
+/* The number of device node lookups, i.e. udev queries, so far */
+unsigned int
+fake_sysfs_get_lookup_count(struct fake_sysfs *sysfs);
+
+/* While blocked, lookups wait until unblocked again, so the tests can
+ * control when an asynchronous lookup finishes */
+void
+fake_sysfs_set_lookups_blocked(struct fake_sysfs *sysfs,
+			       bool blocked);
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,643 @@
+/*
+ * Copyright © 2025 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+
+#include "fake-sysfs.h"
+#include "libwacom.h"
+
+struct fixture {
+	WacomDeviceDatabase *db;
+	struct fake_sysfs *sysfs;
+};
+
+static WacomDeviceDatabase *
+load_database(void)
+{
+	WacomDeviceDatabase *db;
+	const char *datadir;
+
+	datadir = getenv("LIBWACOM_DATA_DIR");
+	if (!datadir)
+		datadir = TOPSRCDIR "/data";
+
+	db = libwacom_database_new_for_path(datadir);
+	if (!db)
+		printf("Failed to load data from %s", datadir);
+
+	g_assert(db);
+	return db;
+}
+
+static void
+fixture_setup(struct fixture *f,
+	      gconstpointer user_data)
+{
+	f->db = load_database();
+	f->sysfs = fake_sysfs_new();
+	f->db->udev = fake_sysfs_get_backend(f->sysfs);
+}
+
+static void
+fixture_teardown(struct fixture *f,
+		 gconstpointer user_data)
+{
+	libwacom_database_destroy(f->db);
+	fake_sysfs_destroy(f->sysfs);
+}
+
+static const struct fake_device pen = {
+	.name = FAKE_TABLET_NAME " Pen",
+	.bustype = FAKE_BUS_USB,
+	.vid = FAKE_TABLET_VID,
+	.pid = FAKE_TABLET_PID,
+	.subsystem = "usb",
+	.tablet = true,
+};
+
+static void
+test_tablet_nodes(struct fixture *f,
+		  gconstpointer user_data)
+{
+	const struct fake_device pad = {
+		.name = FAKE_TABLET_NAME " Pad",
+		.bustype = FAKE_BUS_USB,
+		.vid = FAKE_TABLET_VID,
+		.pid = FAKE_TABLET_PID,
+		.subsystem = "usb",
+		.tablet = true,
+	};
+	const struct fake_device touch = {
+		.name = FAKE_TABLET_NAME " Finger",
+		.bustype = FAKE_BUS_USB,
+		.vid = FAKE_TABLET_VID,
+		.pid = FAKE_TABLET_PID,
+		.subsystem = "usb",
+		.touchpad = true,
+	};
+	const struct fake_device *devices[] = { &pen, &pad, &touch };
+
+	for (size_t i = 0; i < G_N_ELEMENTS(devices); i++) {
+		const char *devnode = fake_sysfs_add_device(f->sysfs, devices[i]);
+		WacomDevice *device;
+
+		device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+		g_assert_nonnull(device);
+		g_assert_cmpstr(libwacom_get_name(device), ==, FAKE_TABLET_NAME);
+		g_assert_cmpint(libwacom_get_vendor_id(device), ==, FAKE_TABLET_VID);
+		g_assert_cmpint(libwacom_get_product_id(device), ==, FAKE_TABLET_PID);
+		g_assert_cmpint(libwacom_get_bustype(device), ==, WBUSTYPE_USB);
+		libwacom_destroy(device);
+	}
+}
+
+static void
+test_not_a_tablet(struct fixture *f,
+		  gconstpointer user_data)
+{
+	const struct fake_device keyboard = {
+		.name = "AT Translated Set 2 keyboard",
+		.bustype = FAKE_BUS_I8042,
+		.vid = 0x1,
+		.pid = 0x1,
+		.subsystem = "serio",
+	};
+	const struct fake_device mouse = {
+		.name = "Logitech USB Optical Mouse",
+		.bustype = FAKE_BUS_USB,
+		.vid = 0x46d,
+		.pid = 0xc077,
+		.subsystem = "usb",
+	};
+	const struct fake_device *devices[] = { &keyboard, &mouse };
+
+	for (size_t i = 0; i < G_N_ELEMENTS(devices); i++) {
+		const char *devnode = fake_sysfs_add_device(f->sysfs, devices[i]);
+		WacomError *error = libwacom_error_new();
+		WacomDevice *device;
+
+		device = libwacom_new_from_path(f->db, devnode, WFALLBACK_GENERIC, error);
+		g_assert_null(device);
+		g_assert_cmpint(libwacom_error_get_code(error), ==, WERROR_INVALID_PATH);
+		libwacom_error_free(&error);
+	}
+}
+
+static void
+test_unknown_node(struct fixture *f,
+		  gconstpointer user_data)
+{
+	WacomError *error = libwacom_error_new();
+	g_autofree char *devnode = NULL;
+	WacomDevice *device;
+
+	fake_sysfs_add_device(f->sysfs, &pen);
+	devnode = g_build_filename(fake_sysfs_get_devinput_dir(f->sysfs),
+				   "event1234",
+				   NULL);
+
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_GENERIC, error);
+	g_assert_null(device);
+	g_assert_cmpint(libwacom_error_get_code(error), ==, WERROR_INVALID_PATH);
+	libwacom_error_free(&error);
+}
+
+static void
+test_uinput_subsystem(struct fixture *f,
+		      gconstpointer user_data)
+{
+	const struct fake_device uinput = {
+		.name = "Wacom Serial Penabled Pen",
+		.bustype = FAKE_BUS_RS232,
+		.vid = FAKE_TABLET_VID,
+		.pid = 0x0,
+		.uinput_subsystem = "serial",
+		.tablet = true,
+	};
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &uinput);
+	WacomDevice *device;
+
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpint(libwacom_get_bustype(device), ==, WBUSTYPE_SERIAL);
+	g_assert_cmpint(libwacom_get_vendor_id(device), ==, 0);
+	g_assert_cmpint(libwacom_get_product_id(device), ==, 0);
+	libwacom_destroy(device);
+}
+
+static void
+test_fallback(struct fixture *f,
+	      gconstpointer user_data)
+{
+	const struct fake_device unknown = {
+		.name = "Unknown Pen Display",
+		.bustype = FAKE_BUS_USB,
+		.vid = 0x1234,
+		.pid = 0xabcd,
+		.subsystem = "usb",
+		.tablet = true,
+	};
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &unknown);
+	WacomDevice *device;
+
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_null(device);
+
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_GENERIC, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, unknown.name);
+	g_assert_cmpint(libwacom_get_vendor_id(device), ==, 0);
+	g_assert_cmpint(libwacom_get_product_id(device), ==, 0);
+	libwacom_destroy(device);
+}
+
+static void
+test_populate(struct fixture *f,
+	      gconstpointer user_data)
+{
+	const struct fake_sysfs_config config = {
+		.tablets = 2,
+		.pads = 2,
+		.touch = 2,
+		.keyboards = 3,
+		.mice = 3,
+		.uinput = 2,
+	};
+	const char *devinput = fake_sysfs_get_devinput_dir(f->sysfs);
+	unsigned int found = 0, total = 0;
+	const char *name;
+	GDir *dir;
+
+	fake_sysfs_populate(f->sysfs, &config);
+
+	dir = g_dir_open(devinput, 0, NULL);
+	g_assert_nonnull(dir);
+	while ((name = g_dir_read_name(dir))) {
+		g_autofree char *devnode = g_build_filename(devinput, name, NULL);
+		WacomDevice *device;
+
+		total++;
+		device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+		if (device) {
+			found++;
+			libwacom_destroy(device);
+		}
+	}
+	g_dir_close(dir);
+
+	g_assert_cmpint(total, ==, 14);
+	g_assert_cmpint(found, ==, 8);
+}
+
+static void
+test_cache_hit(struct fixture *f,
+	       gconstpointer user_data)
+{
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &pen);
+	WacomDevice *d1, *d2, *d3;
+	unsigned int lookups;
+
+	/* Disabled by default */
+	d1 = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	d2 = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_nonnull(d1);
+	g_assert_nonnull(d2);
+	g_assert_true(d1 != d2);
+	libwacom_destroy(d1);
+	libwacom_destroy(d2);
+
+	libwacom_database_set_path_cache(f->db, TRUE);
+	d1 = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	lookups = fake_sysfs_get_lookup_count(f->sysfs);
+	d2 = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_nonnull(d1);
+	g_assert_true(d1 == d2);
+	g_assert_cmpint(fake_sysfs_get_lookup_count(f->sysfs), ==, lookups);
+
+	/* Different fallback flags, different entry */
+	d3 = libwacom_new_from_path(f->db, devnode, WFALLBACK_GENERIC, NULL);
+	g_assert_nonnull(d3);
+	g_assert_true(d3 != d1);
+	g_assert_cmpint(fake_sysfs_get_lookup_count(f->sysfs), ==, lookups + 1);
+	libwacom_destroy(d3);
+
+	/* Cached devices outlive the cache */
+	libwacom_database_set_path_cache(f->db, FALSE);
+	g_assert_cmpstr(libwacom_get_name(d1), ==, FAKE_TABLET_NAME);
+	libwacom_destroy(d1);
+	g_assert_cmpstr(libwacom_get_name(d2), ==, FAKE_TABLET_NAME);
+	libwacom_destroy(d2);
+}
+
+static void
+test_cache_node_reused(struct fixture *f,
+		       gconstpointer user_data)
+{
+	const struct fake_device mouse = {
+		.name = "Logitech USB Optical Mouse",
+		.bustype = FAKE_BUS_USB,
+		.vid = 0x46d,
+		.pid = 0xc077,
+		.subsystem = "usb",
+	};
+	const struct fake_device uinput = {
+		.name = "Wacom Serial Penabled Pen",
+		.bustype = FAKE_BUS_RS232,
+		.vid = FAKE_TABLET_VID,
+		.pid = 0x0,
+		.uinput_subsystem = "serial",
+		.tablet = true,
+	};
+	g_autofree char *devnode = NULL;
+	WacomDevice *device;
+
+	libwacom_database_set_path_cache(f->db, TRUE);
+
+	devnode = g_strdup(fake_sysfs_add_device(f->sysfs, &pen));
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpint(libwacom_get_bustype(device), ==, WBUSTYPE_USB);
+	libwacom_destroy(device);
+
+	/* Unplugged */
+	fake_sysfs_remove_device(f->sysfs, devnode);
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_null(device);
+
+	/* Node reused by a different, non-tablet device */
+	g_assert_cmpstr(fake_sysfs_add_device(f->sysfs, &mouse), ==, devnode);
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_null(device);
+	fake_sysfs_remove_device(f->sysfs, devnode);
+
+	/* And by a different tablet */
+	g_assert_cmpstr(fake_sysfs_add_device(f->sysfs, &uinput), ==, devnode);
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpint(libwacom_get_bustype(device), ==, WBUSTYPE_SERIAL);
+	libwacom_destroy(device);
+}
+
+#define H1060P_NAME "HUION H1060P Tablet"
+
+static void
+test_uniq_default(struct fixture *f,
+		  gconstpointer user_data)
+{
+	const struct fake_device h1060p = {
+		.name = "Tablet Monitor Pen",
+		.uniq = "HUION_T167_190827",
+		.bustype = FAKE_BUS_USB,
+		.vid = 0x256c,
+		.pid = 0x006d,
+		.subsystem = "usb",
+		.tablet = true,
+	};
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &h1060p);
+	WacomDevice *device;
+
+	/* Matched by its uniq with the firmware version removed */
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, H1060P_NAME);
+	libwacom_destroy(device);
+}
+
+static void
+test_uniq_custom_rules(struct fixture *f,
+		       gconstpointer user_data)
+{
+	const struct fake_device h1060p = {
+		.name = "Tablet Monitor Pen",
+		.uniq = "HUION_T167-v2.1",
+		.bustype = FAKE_BUS_USB,
+		.vid = 0x256c,
+		.pid = 0x006d,
+		.subsystem = "usb",
+		.tablet = true,
+	};
+	const char *rules =
+		"[Dashed]\n"
+		"Prefix=HUION_\n"
+		"Separator=-\n"
+		"StripFields=1\n";
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &h1060p);
+	g_autoptr(GError) error = NULL;
+	g_autofree char *tmpdir = NULL;
+	g_autofree char *rulefile = NULL;
+	g_autofree char *datadirs = NULL;
+	WacomDeviceDatabase *db;
+	WacomDevice *device;
+
+	/* The default rule leaves this uniq alone */
+	device = libwacom_new_from_path(f->db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_true(!device || !g_str_equal(libwacom_get_name(device), H1060P_NAME));
+	libwacom_destroy(device);
+
+	tmpdir = g_dir_make_tmp("libwacom-uniq-XXXXXX", &error);
+	g_assert_no_error(error);
+	rulefile = g_build_filename(tmpdir, "vendor.uniq", NULL);
+	g_file_set_contents(rulefile, rules, -1, &error);
+	g_assert_no_error(error);
+
+	datadirs = g_strdup_printf("%s:%s", tmpdir, TOPSRCDIR "/data");
+	db = libwacom_database_new_for_path(datadirs);
+	g_assert_nonnull(db);
+	db->udev = fake_sysfs_get_backend(f->sysfs);
+
+	device = libwacom_new_from_path(db, devnode, WFALLBACK_NONE, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, H1060P_NAME);
+	libwacom_destroy(device);
+
+	libwacom_database_destroy(db);
+	g_unlink(rulefile);
+	g_rmdir(tmpdir);
+}
+
+struct async_slot {
+	bool done;
+	WacomDevice *device;
+	enum WacomErrorCode code;
+};
+
+static void
+async_done(GObject *source,
+	   GAsyncResult *result,
+	   gpointer data)
+{
+	struct async_slot *slot = data;
+	WacomError *error = libwacom_error_new();
+
+	g_assert_null(source);
+
+	slot->device = libwacom_new_from_path_finish(result, error);
+	slot->code = libwacom_error_get_code(error);
+	slot->done = true;
+	libwacom_error_free(&error);
+}
+
+static void
+wait_for(struct async_slot *slot)
+{
+	while (!slot->done)
+		g_main_context_iteration(NULL, TRUE);
+}
+
+static void
+test_async_coalesce(struct fixture *f,
+		    gconstpointer user_data)
+{
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &pen);
+	struct async_slot slots[3] = { 0 };
+	unsigned int lookups = fake_sysfs_get_lookup_count(f->sysfs);
+
+	/* Keep the first lookup from finishing before all requests are in */
+	fake_sysfs_set_lookups_blocked(f->sysfs, true);
+	for (size_t i = 0; i < G_N_ELEMENTS(slots); i++)
+		libwacom_new_from_path_async(f->db,
+					     devnode,
+					     WFALLBACK_NONE,
+					     NULL,
+					     async_done,
+					     &slots[i]);
+	fake_sysfs_set_lookups_blocked(f->sysfs, false);
+
+	for (size_t i = 0; i < G_N_ELEMENTS(slots); i++) {
+		wait_for(&slots[i]);
+		g_assert_nonnull(slots[i].device);
+		g_assert_cmpint(slots[i].code, ==, WERROR_NONE);
+		g_assert_true(slots[i].device == slots[0].device);
+	}
+	g_assert_cmpstr(libwacom_get_name(slots[0].device), ==, FAKE_TABLET_NAME);
+	g_assert_cmpint(fake_sysfs_get_lookup_count(f->sysfs), ==, lookups + 1);
+
+	for (size_t i = 0; i < G_N_ELEMENTS(slots); i++)
+		libwacom_destroy(slots[i].device);
+}
+
+static void
+test_async_cancel(struct fixture *f,
+		  gconstpointer user_data)
+{
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &pen);
+	g_autoptr(GCancellable) cancellable = g_cancellable_new();
+	struct async_slot cancelled = { 0 };
+	struct async_slot other = { 0 };
+
+	fake_sysfs_set_lookups_blocked(f->sysfs, true);
+	libwacom_new_from_path_async(f->db,
+				     devnode,
+				     WFALLBACK_NONE,
+				     cancellable,
+				     async_done,
+				     &cancelled);
+	libwacom_new_from_path_async(f->db,
+				     devnode,
+				     WFALLBACK_NONE,
+				     NULL,
+				     async_done,
+				     &other);
+
+	/* Completes while the shared lookup is still blocked */
+	g_cancellable_cancel(cancellable);
+	wait_for(&cancelled);
+	g_assert_null(cancelled.device);
+	g_assert_cmpint(cancelled.code, ==, WERROR_CANCELLED);
+	g_assert_false(other.done);
+
+	fake_sysfs_set_lookups_blocked(f->sysfs, false);
+	wait_for(&other);
+	g_assert_nonnull(other.device);
+	libwacom_destroy(other.device);
+}
+
+static void
+test_async_errors(struct fixture *f,
+		  gconstpointer user_data)
+{
+	const struct fake_device mouse = {
+		.name = "Logitech USB Optical Mouse",
+		.bustype = FAKE_BUS_USB,
+		.vid = 0x46d,
+		.pid = 0xc077,
+		.subsystem = "usb",
+	};
+	const char *devnode = fake_sysfs_add_device(f->sysfs, &mouse);
+	struct async_slot slots[2] = { 0 };
+
+	libwacom_new_from_path_async(f->db,
+				     NULL,
+				     WFALLBACK_NONE,
+				     NULL,
+				     async_done,
+				     &slots[0]);
+	libwacom_new_from_path_async(f->db,
+				     devnode,
+				     WFALLBACK_GENERIC,
+				     NULL,
+				     async_done,
+				     &slots[1]);
+
+	for (size_t i = 0; i < G_N_ELEMENTS(slots); i++) {
+		wait_for(&slots[i]);
+		g_assert_null(slots[i].device);
+		g_assert_cmpint(slots[i].code, ==, WERROR_INVALID_PATH);
+	}
+}
+
+int
+main(int argc,
+     char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	g_test_set_nonfatal_assertions();
+
+	g_test_add("/device-path/tablet-nodes",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_tablet_nodes,
+		   fixture_teardown);
+	g_test_add("/device-path/not-a-tablet",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_not_a_tablet,
+		   fixture_teardown);
+	g_test_add("/device-path/unknown-node",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_unknown_node,
+		   fixture_teardown);
+	g_test_add("/device-path/uinput-subsystem",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_uinput_subsystem,
+		   fixture_teardown);
+	g_test_add("/device-path/fallback",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_fallback,
+		   fixture_teardown);
+	g_test_add("/device-path/populate",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_populate,
+		   fixture_teardown);
+	g_test_add("/device-path/cache/hit",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_cache_hit,
+		   fixture_teardown);
+	g_test_add("/device-path/cache/node-reused",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_cache_node_reused,
+		   fixture_teardown);
+	g_test_add("/device-path/uniq/default",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_uniq_default,
+		   fixture_teardown);
+	g_test_add("/device-path/uniq/custom-rules",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_uniq_custom_rules,
+		   fixture_teardown);
+	g_test_add("/device-path/async/coalesce",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_async_coalesce,
+		   fixture_teardown);
+	g_test_add("/device-path/async/cancel",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_async_cancel,
+		   fixture_teardown);
+	g_test_add("/device-path/async/errors",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_async_errors,
+		   fixture_teardown);
+
+	return g_test_run();
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
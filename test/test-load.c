@@ -26,8 +26,13 @@
 
 #include "config.h"
 
+#define _GNU_SOURCE
+#include <fcntl.h>
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "libwacom.h"
 #include "linux/input-event-codes.h"
@@ -99,6 +104,10 @@ test_invalid_device(struct fixture *f,
 {
 	WacomDevice *device = libwacom_new_from_usbid(f->db, 0, 0, NULL);
 	g_assert_null(device);
+
+	/* IDs are 16 bit, this must not be mistaken for 056a:00bc */
+	device = libwacom_new_from_usbid(f->db, 0x1056a, 0x00bc, NULL);
+	g_assert_null(device);
 }
 
 static void
@@ -117,6 +126,10 @@ test_intuos4(struct fixture *f,
 	g_assert_cmpint(libwacom_get_product_id(device), ==, 0xbc);
 	g_assert_cmpint(libwacom_get_bustype(device), ==, WBUSTYPE_USB);
 	g_assert_cmpint(libwacom_get_num_buttons(device), ==, 9);
+	g_assert_cmpint(libwacom_get_button_flag(device, 'I'), !=, WACOM_BUTTON_NONE);
+	g_assert_cmpint(libwacom_get_button_flag(device, 'J'), ==, WACOM_BUTTON_NONE);
+	g_assert_cmpint(libwacom_get_button_flag(device, 'a'), ==, WACOM_BUTTON_NONE);
+	g_assert_cmpint(libwacom_get_button_evdev_code(device, 'Z' + 1), ==, 0);
 	g_assert_true(libwacom_has_stylus(device));
 	g_assert_true(libwacom_is_reversible(device));
 	g_assert_false(libwacom_has_touch(device));
@@ -170,11 +183,35 @@ test_cintiq24hd(struct fixture *f,
 		gconstpointer user_data)
 {
 	WacomDevice *device = libwacom_new_from_usbid(f->db, 0x56a, 0x00f4, NULL);
+	const int *led_groups;
+	int num_buttons;
+
 	g_assert_nonnull(device);
 
 	g_assert_cmpint(libwacom_get_ring_num_modes(device), ==, 3);
 	g_assert_cmpint(libwacom_get_ring2_num_modes(device), ==, 3);
 
+	/* StatusLEDs=Ring2;Ring */
+	led_groups = libwacom_get_button_led_groups(device, &num_buttons);
+	g_assert_cmpint(num_buttons, ==, libwacom_get_num_buttons(device));
+	for (int i = 0; i < num_buttons; i++) {
+		switch ('A' + i) {
+		case 'A':
+		case 'B':
+		case 'C':
+			g_assert_cmpint(led_groups[i], ==, 1);
+			break;
+		case 'I':
+		case 'J':
+		case 'K':
+			g_assert_cmpint(led_groups[i], ==, 0);
+			break;
+		default:
+			g_assert_cmpint(led_groups[i], ==, -1);
+			break;
+		}
+	}
+
 	libwacom_destroy(device);
 }
 
@@ -245,6 +282,11 @@ test_cintiq13hd(struct fixture *f,
 	g_assert_cmpint(libwacom_get_button_evdev_code(device, 'G'), ==, BTN_6);
 	g_assert_cmpint(libwacom_get_button_evdev_code(device, 'H'), ==, BTN_7);
 	g_assert_cmpint(libwacom_get_button_evdev_code(device, 'I'), ==, BTN_8);
+	g_assert_cmpint(libwacom_get_button_for_evdev_code(device, BTN_0), ==, 'A');
+	g_assert_cmpint(libwacom_get_button_for_evdev_code(device, BTN_8), ==, 'I');
+	g_assert_cmpint(libwacom_get_button_for_evdev_code(device, BTN_9), ==, 0);
+	g_assert_cmpint(libwacom_get_button_for_evdev_code(device, BTN_STYLUS), ==, 0);
+	g_assert_cmpint(libwacom_get_button_for_evdev_code(device, KEY_A), ==, 0);
 	g_assert_cmpstr(libwacom_get_model_name(device), ==, "DTK-1300");
 
 	libwacom_destroy(device);
@@ -258,6 +300,20 @@ test_cintiqpro13(struct fixture *f,
 		libwacom_new_from_name(f->db, "Wacom Cintiq Pro 13", NULL);
 	g_assert_nonnull(device);
 	g_assert_cmpint(libwacom_get_num_keys(device), ==, 5);
+	g_assert_cmpint(libwacom_get_key_for_code(device, EV_KEY, KEY_CONTROLPANEL),
+			==,
+			1);
+	g_assert_cmpint(libwacom_get_key_for_code(device, EV_KEY, KEY_BUTTONCONFIG),
+			==,
+			3);
+	g_assert_cmpint(libwacom_get_key_for_code(device, EV_SW, SW_MUTE_DEVICE),
+			==,
+			4);
+	g_assert_cmpint(libwacom_get_key_for_code(device, EV_KEY, SW_MUTE_DEVICE),
+			==,
+			-1);
+	g_assert_cmpint(libwacom_get_key_for_code(device, EV_KEY, 0), ==, -1);
+	g_assert_cmpint(libwacom_get_key_for_code(device, EV_KEY, BTN_0), ==, -1);
 
 	libwacom_destroy(device);
 }
@@ -311,6 +367,781 @@ test_isdv4_4800(struct fixture *f,
 	libwacom_destroy(device);
 }
 
+static void
+test_outlives_database(struct fixture *f,
+		       gconstpointer user_data)
+{
+	WacomDeviceDatabase *db = load_database();
+	WacomBuilder *builder = libwacom_builder_new();
+	WacomDevice *device, *copy, *fallback;
+	const char *layout;
+
+	device = libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL);
+	copy = libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(device);
+	g_assert_nonnull(copy);
+	/* The strings are shared, not duplicated per device */
+	g_assert_true(libwacom_get_name(device) == libwacom_get_name(copy));
+	g_assert_true(libwacom_get_layout_filename(device) ==
+		      libwacom_get_layout_filename(copy));
+
+	libwacom_builder_set_usbid(builder, 0x1234, 0x5678);
+	libwacom_builder_set_device_name(builder, "Some Unknown Tablet");
+	fallback = libwacom_new_from_builder(db, builder, WFALLBACK_GENERIC, NULL);
+	g_assert_nonnull(fallback);
+	libwacom_builder_destroy(builder);
+
+	libwacom_database_destroy(db);
+
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 WL");
+	g_assert_cmpstr(libwacom_get_model_name(device), ==, "PTK-540WL");
+	layout = libwacom_get_layout_filename(device);
+	g_assert_nonnull(layout);
+	g_assert_true(g_str_has_suffix(layout, "/wacom-intuos4-6x9-wl.svg"));
+	g_assert_cmpstr(libwacom_match_get_match_string(libwacom_get_matches(device)[0]),
+			==,
+			"usb|056a|00bc");
+	g_assert_cmpstr(libwacom_get_name(fallback), ==, "Some Unknown Tablet");
+
+	libwacom_destroy(device);
+	libwacom_destroy(copy);
+	libwacom_destroy(fallback);
+}
+
+static void
+test_deprecated_ids(struct fixture *f,
+		    gconstpointer user_data)
+{
+	WacomDevice *device;
+	const WacomStylus **styli;
+	const int *ids, *ids2;
+	int nids, nids2, nstyli, n = 0;
+
+	device = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(device);
+
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	ids = libwacom_get_supported_styli(device, &nids);
+	ids2 = libwacom_get_supported_styli(device, &nids2);
+	G_GNUC_END_IGNORE_DEPRECATIONS
+
+	/* Built once, then the same array is returned */
+	g_assert_true(ids == ids2);
+	g_assert_cmpint(nids, ==, nids2);
+
+	styli = libwacom_get_styli(device, &nstyli);
+	for (int i = 0; i < nstyli; i++) {
+		const WacomStylus *stylus = styli[i];
+		const WacomStylus **paired;
+		const int *paired_ids;
+		int npaired, npaired_ids;
+		int vid = libwacom_stylus_get_vendor_id(stylus);
+
+		if (vid == 0 || vid == 0x56a) {
+			g_assert_cmpint(n, <, nids);
+			g_assert_cmpint(ids[n++], ==, libwacom_stylus_get_id(stylus));
+		}
+
+		G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+		paired_ids = libwacom_stylus_get_paired_ids(stylus, &npaired_ids);
+		g_assert_true(paired_ids ==
+			      libwacom_stylus_get_paired_ids(stylus, NULL));
+		G_GNUC_END_IGNORE_DEPRECATIONS
+
+		paired = libwacom_stylus_get_paired_styli(stylus, &npaired);
+		for (int j = 0; j < npaired; j++) {
+			gboolean found = FALSE;
+
+			vid = libwacom_stylus_get_vendor_id(paired[j]);
+			if (vid != 0 && vid != 0x56a)
+				continue;
+
+			for (int k = 0; k < npaired_ids; k++) {
+				if (paired_ids[k] == libwacom_stylus_get_id(paired[j]))
+					found = TRUE;
+			}
+			g_assert_true(found);
+		}
+		g_free(paired);
+	}
+	g_assert_cmpint(n, ==, nids);
+
+	g_free(styli);
+	libwacom_destroy(device);
+}
+
+static void
+test_stats(struct fixture *f,
+	   gconstpointer user_data)
+{
+	WacomDatabaseStats *before, *during, *after;
+	WacomDevice *device;
+
+	before = libwacom_database_get_stats(f->db);
+	g_assert_cmpuint(before->num_devices, >, 0);
+	g_assert_cmpuint(before->num_matches, >=, before->num_devices);
+	g_assert_cmpuint(before->num_styli, >, 0);
+	g_assert_cmpuint(before->num_buttons, >, 0);
+	g_assert_cmpuint(before->num_strings, >, 0);
+	g_assert_cmpuint(before->num_handles, ==, 0);
+	g_assert_cmpuint(before->arena_bytes,
+			 >=,
+			 before->devices_bytes + before->matches_bytes +
+				 before->styli_bytes + before->buttons_bytes +
+				 before->strings_bytes);
+
+	device = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(device);
+	during = libwacom_database_get_stats(f->db);
+	g_assert_cmpuint(during->num_devices, ==, before->num_devices);
+	g_assert_cmpuint(during->num_handles, ==, 1);
+	g_assert_cmpuint(during->handles_bytes, >, 0);
+
+	libwacom_destroy(device);
+	after = libwacom_database_get_stats(f->db);
+	g_assert_cmpuint(after->num_handles, ==, 0);
+
+	free(before);
+	free(during);
+	free(after);
+}
+
+static void
+test_stylus_resolver(struct fixture *f,
+		     gconstpointer user_data)
+{
+	WacomDevice **devices, **device;
+	const WacomStylus **all_styli, **stylus;
+
+	devices = libwacom_list_devices_from_database(f->db, NULL);
+	all_styli = libwacom_list_styli_from_database(f->db, NULL);
+	g_assert_nonnull(devices);
+	g_assert_nonnull(all_styli);
+
+	for (device = devices; *device; device++) {
+		WacomStylusResolver *resolver;
+		const WacomStylus **styli;
+		int nstyli;
+
+		resolver = libwacom_stylus_resolver_new(f->db, *device);
+		styli = libwacom_get_styli(*device, &nstyli);
+
+		for (stylus = all_styli; *stylus; stylus++) {
+			int vid = libwacom_stylus_get_vendor_id(*stylus);
+			int tool_id = libwacom_stylus_get_id(*stylus);
+			gboolean supported = FALSE;
+
+			g_assert_true(libwacom_stylus_resolver_lookup(resolver,
+								      vid,
+								      tool_id) == *stylus);
+
+			for (int i = 0; i < nstyli; i++) {
+				if (styli[i] == *stylus)
+					supported = TRUE;
+			}
+			g_assert_cmpint(libwacom_stylus_resolver_is_supported(resolver,
+									      *stylus),
+					==,
+					supported);
+		}
+
+		/* The generic styli are found with any vendor ID */
+		G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+		g_assert_true(libwacom_stylus_resolver_lookup(resolver, 0x56a, 0xfffff) ==
+			      libwacom_stylus_get_for_id(f->db, 0xfffff));
+		G_GNUC_END_IGNORE_DEPRECATIONS
+		g_assert_nonnull(libwacom_stylus_resolver_lookup(resolver, 0x56a, 0xfffff));
+		g_assert_null(libwacom_stylus_resolver_lookup(resolver, 0x56a, 0x12345678));
+
+		g_free(styli);
+		libwacom_stylus_resolver_destroy(resolver);
+	}
+
+	free(all_styli);
+	free(devices);
+}
+
+static void
+test_stylus_for_vid_and_id(struct fixture *f,
+			   gconstpointer user_data)
+{
+	const WacomStylus **all_styli, **stylus;
+
+	all_styli = libwacom_list_styli_from_database(f->db, NULL);
+	g_assert_nonnull(all_styli);
+
+	for (stylus = all_styli; *stylus; stylus++) {
+		int vid = libwacom_stylus_get_vendor_id(*stylus);
+		int tool_id = libwacom_stylus_get_id(*stylus);
+
+		g_assert_true(libwacom_stylus_get_for_vid_and_id(f->db, vid, tool_id) ==
+			      *stylus);
+	}
+
+	/* The generic styli are found with any vendor ID */
+	g_assert_nonnull(libwacom_stylus_get_for_vid_and_id(f->db, 0x56a, 0xfffff));
+	g_assert_true(libwacom_stylus_get_for_vid_and_id(f->db, 0x56a, 0xfffff) ==
+		      libwacom_stylus_get_for_vid_and_id(f->db, 0, 0xfffff));
+	g_assert_null(libwacom_stylus_get_for_vid_and_id(f->db, 0x56a, 0x12345678));
+	g_assert_null(libwacom_stylus_get_for_vid_and_id(f->db, 0x1234, 0x802));
+	g_assert_null(libwacom_stylus_get_for_vid_and_id(f->db, 0x56a, 0));
+
+	free(all_styli);
+}
+
+static void
+check_exported_styli(const WacomStylus **styli,
+		     const WacomStylusTable *table)
+{
+	for (size_t i = 0; i < table->num_records; i++) {
+		const WacomStylus *stylus = styli[i];
+		const WacomStylusRecord *record = &table->records[i];
+
+		g_assert_nonnull(stylus);
+		g_assert_cmpint(record->vendor_id,
+				==,
+				libwacom_stylus_get_vendor_id(stylus));
+		g_assert_cmpint(record->tool_id, ==, libwacom_stylus_get_id(stylus));
+		g_assert_cmpstr(table->strings + record->name,
+				==,
+				libwacom_stylus_get_name(stylus));
+		g_assert_cmpint(record->axes, ==, libwacom_stylus_get_axes(stylus));
+		g_assert_cmpint(record->type, ==, libwacom_stylus_get_type(stylus));
+		g_assert_cmpint(record->eraser_type,
+				==,
+				libwacom_stylus_get_eraser_type(stylus));
+		g_assert_cmpint(record->num_buttons,
+				==,
+				libwacom_stylus_get_num_buttons(stylus));
+		g_assert_cmpint(!!(record->flags & WACOM_STYLUS_RECORD_HAS_ERASER),
+				==,
+				!!libwacom_stylus_has_eraser(stylus));
+		g_assert_cmpint(!!(record->flags & WACOM_STYLUS_RECORD_IS_ERASER),
+				==,
+				!!libwacom_stylus_is_eraser(stylus));
+		g_assert_cmpint(!!(record->flags & WACOM_STYLUS_RECORD_HAS_LENS),
+				==,
+				!!libwacom_stylus_has_lens(stylus));
+		g_assert_cmpint(!!(record->flags & WACOM_STYLUS_RECORD_HAS_WHEEL),
+				==,
+				!!libwacom_stylus_has_wheel(stylus));
+		g_assert_cmpint(record->paired_first + record->num_paired,
+				<=,
+				table->num_paired);
+
+		for (uint32_t j = 0; j < record->num_paired; j++) {
+			uint32_t index = table->paired[record->paired_first + j];
+			const WacomStylus **paired;
+			gboolean found = FALSE;
+			int num_paired;
+
+			g_assert_cmpint(index, <, table->num_records);
+			paired = libwacom_stylus_get_paired_styli(stylus, &num_paired);
+			for (int k = 0; k < num_paired; k++)
+				found |= paired[k] == styli[index];
+			g_assert_true(found);
+			g_free(paired);
+		}
+	}
+}
+
+static void
+test_export_styli(struct fixture *f,
+		  gconstpointer user_data)
+{
+	WacomStylusTable table = { 0 };
+	const WacomStylus **all_styli;
+	WacomDevice **devices;
+	size_t num_styli = 0, num_paired, strings_size;
+
+	all_styli = libwacom_list_styli_from_database(f->db, NULL);
+	while (all_styli[num_styli])
+		num_styli++;
+
+	/* The sizes first, nothing is written */
+	g_assert_cmpint(libwacom_database_export_styli(f->db, NULL, &table), ==, -1);
+	g_assert_cmpint(table.num_records, ==, num_styli);
+	g_assert_cmpint(table.num_paired, >, 0);
+	g_assert_cmpint(table.strings_size, >, 0);
+	num_paired = table.num_paired;
+	strings_size = table.strings_size;
+
+	table.records = g_new0(WacomStylusRecord, table.num_records);
+	table.paired = g_new0(uint32_t, table.num_paired);
+	table.strings = g_new0(char, table.strings_size);
+
+	memset(table.records, 0xff, table.num_records * sizeof(*table.records));
+	table.num_paired--;
+	g_assert_cmpint(libwacom_database_export_styli(f->db, NULL, &table), ==, -1);
+	g_assert_cmpint(table.records[0].vendor_id, ==, 0xffffffff);
+
+	g_assert_cmpint(libwacom_database_export_styli(f->db, NULL, &table), ==, 0);
+	g_assert_cmpint(table.num_records, ==, num_styli);
+	check_exported_styli(all_styli, &table);
+
+	/* The buffers are large enough for any device */
+	devices = libwacom_list_devices_from_database(f->db, NULL);
+	for (WacomDevice **device = devices; *device; device++) {
+		const WacomStylus **device_styli;
+		int num_device_styli;
+
+		table.num_records = num_styli;
+		table.num_paired = num_paired;
+		table.strings_size = strings_size;
+		device_styli = libwacom_get_styli(*device, &num_device_styli);
+		g_assert_cmpint(libwacom_database_export_styli(f->db, *device, &table),
+				==,
+				0);
+		g_assert_cmpint(table.num_records, ==, num_device_styli);
+		check_exported_styli(device_styli, &table);
+		g_free(device_styli);
+	}
+
+	free(devices);
+	g_free(table.records);
+	g_free(table.paired);
+	g_free(table.strings);
+	free(all_styli);
+}
+
+static void
+test_device_descriptor(struct fixture *f,
+		       gconstpointer user_data)
+{
+	WacomDevice *device = libwacom_new_from_usbid(f->db, 0x56a, 0x00f8, NULL);
+	WacomDeviceDescriptor d;
+	struct {
+		WacomDeviceDescriptor d;
+		char newer_fields[32];
+	} larger;
+	size_t older_size = offsetof(WacomDeviceDescriptor, num_buttons);
+
+	/* The fields are compared for every device in test_libwacom.py,
+	 * this covers callers built against other versions */
+	g_assert_nonnull(device);
+
+	g_assert_cmpint(libwacom_device_get_descriptor(device, &d, sizeof(d)), ==, 0);
+	g_assert_cmpint(d.version, ==, WACOM_DEVICE_DESCRIPTOR_VERSION);
+	g_assert_cmpint(d.size, ==, sizeof(d));
+	g_assert_cmpint(d.num_rings, ==, 2);
+
+	/* A caller compiled against an older version */
+	memset(&d, 0xff, sizeof(d));
+	g_assert_cmpint(libwacom_device_get_descriptor(device, &d, older_size), ==, 0);
+	g_assert_cmpint(d.size, ==, older_size);
+	g_assert_cmpint(d.num_rings, ==, 2);
+	g_assert_cmpint(d.num_buttons, ==, 0xffffffff);
+
+	/* A caller compiled against a newer version */
+	memset(&larger, 0xff, sizeof(larger));
+	g_assert_cmpint(libwacom_device_get_descriptor(device,
+						       &larger.d,
+						       sizeof(larger)),
+			==,
+			0);
+	g_assert_cmpint(larger.d.size, ==, sizeof(larger.d));
+	for (size_t i = 0; i < sizeof(larger.newer_fields); i++)
+		g_assert_cmpint(larger.newer_fields[i], ==, 0);
+
+	g_assert_cmpint(libwacom_device_get_descriptor(device, &d, 4), ==, -1);
+
+	libwacom_destroy(device);
+}
+
+static void
+test_pad_mode_tracker(struct fixture *f,
+		      gconstpointer user_data)
+{
+	WacomDevice *device;
+	WacomPadModeTracker *tracker;
+	int mode = -1;
+
+	/* Direct mode switch buttons, Ring2 has the first LED group */
+	device = libwacom_new_from_usbid(f->db, 0x56a, 0x00f4, NULL);
+	g_assert_nonnull(device);
+	tracker = libwacom_pad_mode_tracker_new(device);
+	libwacom_destroy(device);
+
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_groups(tracker), ==, 2);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_modes(tracker, 0), ==, 3);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_modes(tracker, 1), ==, 3);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_led_group(tracker, 0), ==, 1);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_led_group(tracker, 1), ==, 0);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_mode(tracker, 0), ==, 0);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_mode(tracker, 2), ==, -1);
+
+	g_assert_cmpint(libwacom_pad_mode_tracker_button_pressed(tracker, 'C', &mode),
+			==,
+			0);
+	g_assert_cmpint(mode, ==, 2);
+	g_assert_cmpint(libwacom_pad_mode_tracker_button_pressed(tracker, 'J', &mode),
+			==,
+			1);
+	g_assert_cmpint(mode, ==, 1);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_mode(tracker, 0), ==, 2);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_mode(tracker, 1), ==, 1);
+
+	mode = -1;
+	g_assert_cmpint(libwacom_pad_mode_tracker_button_pressed(tracker, 'D', &mode),
+			==,
+			-1);
+	g_assert_cmpint(mode, ==, -1);
+	g_assert_cmpint(libwacom_pad_mode_tracker_button_pressed(tracker, 0, NULL),
+			==,
+			-1);
+
+	g_assert_true(libwacom_pad_mode_tracker_set_mode(tracker, 1, 0));
+	g_assert_false(libwacom_pad_mode_tracker_set_mode(tracker, 1, 3));
+	g_assert_false(libwacom_pad_mode_tracker_set_mode(tracker, 2, 0));
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_mode(tracker, 1), ==, 0);
+	libwacom_pad_mode_tracker_destroy(tracker);
+
+	/* A single button that cycles through the modes */
+	device = libwacom_new_from_usbid(f->db, 0x56a, 0x0331, NULL);
+	g_assert_nonnull(device);
+	tracker = libwacom_pad_mode_tracker_new(device);
+	libwacom_destroy(device);
+
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_groups(tracker), ==, 1);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_led_group(tracker, 0), ==, 0);
+	for (int i = 1; i <= 6; i++) {
+		g_assert_cmpint(
+			libwacom_pad_mode_tracker_button_pressed(tracker, 'A', &mode),
+			==,
+			0);
+		g_assert_cmpint(mode, ==, i % 3);
+	}
+	libwacom_pad_mode_tracker_destroy(tracker);
+
+	/* Both strips share the number of modes */
+	device = libwacom_new_from_usbid(f->db, 0x56a, 0x00cc, NULL);
+	g_assert_nonnull(device);
+	tracker = libwacom_pad_mode_tracker_new(device);
+	libwacom_destroy(device);
+
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_groups(tracker), ==, 2);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_modes(tracker, 0), ==, 4);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_modes(tracker, 1), ==, 4);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_led_group(tracker, 0), ==, 1);
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_led_group(tracker, 1), ==, 0);
+	g_assert_cmpint(libwacom_pad_mode_tracker_button_pressed(tracker, 'J', &mode),
+			==,
+			1);
+	g_assert_cmpint(mode, ==, 1);
+	libwacom_pad_mode_tracker_destroy(tracker);
+
+	/* No mode switch buttons */
+	device = libwacom_new_from_name(f->db, "Wacom Bamboo Pen", NULL);
+	g_assert_nonnull(device);
+	tracker = libwacom_pad_mode_tracker_new(device);
+	libwacom_destroy(device);
+
+	g_assert_cmpint(libwacom_pad_mode_tracker_get_num_groups(tracker), ==, 0);
+	g_assert_cmpint(libwacom_pad_mode_tracker_button_pressed(tracker, 'A', &mode),
+			==,
+			-1);
+	libwacom_pad_mode_tracker_destroy(tracker);
+}
+
+static void
+test_stylus_devices(struct fixture *f,
+		    gconstpointer user_data)
+{
+	WacomDevice **devices, **device;
+	const WacomStylus **all_styli, **stylus;
+	int total = 0;
+
+	devices = libwacom_list_devices_from_database(f->db, NULL);
+	all_styli = libwacom_list_styli_from_database(f->db, NULL);
+
+	for (device = devices; *device; device++) {
+		const WacomStylus **styli;
+		int nstyli;
+
+		styli = libwacom_get_styli(*device, &nstyli);
+		for (int i = 0; i < nstyli; i++) {
+			WacomDevice *const *supported;
+			gboolean found = FALSE;
+			int nsupported;
+
+			supported = libwacom_stylus_list_devices(styli[i], &nsupported);
+			for (int j = 0; j < nsupported; j++) {
+				if (supported[j] == *device)
+					found = TRUE;
+			}
+			g_assert_true(found);
+		}
+		total += nstyli;
+		g_free(styli);
+	}
+
+	/* And no device the other way round that doesn't list the stylus */
+	for (stylus = all_styli; *stylus; stylus++) {
+		WacomDevice *const *supported;
+		WacomDevice *const *d;
+		int nsupported;
+
+		supported = libwacom_stylus_list_devices(*stylus, &nsupported);
+		g_assert_true(supported == libwacom_stylus_list_devices(*stylus, NULL));
+		g_assert_null(supported[nsupported]);
+		for (d = supported; *d; d++) {
+			/* Sorted like libwacom_list_devices_from_database() */
+			if (d > supported) {
+				int cmp = libwacom_get_vendor_id(d[-1]) -
+					  libwacom_get_vendor_id(d[0]);
+
+				if (cmp == 0)
+					cmp = libwacom_get_product_id(d[-1]) -
+					      libwacom_get_product_id(d[0]);
+				g_assert_cmpint(cmp, <=, 0);
+			}
+		}
+		total -= nsupported;
+	}
+	g_assert_cmpint(total, ==, 0);
+
+	free(all_styli);
+	free(devices);
+}
+
+static void
+test_freeze(struct fixture *f,
+	    gconstpointer user_data)
+{
+	WacomBuilder *builder = libwacom_builder_new();
+	WacomDevice *device, *fallback;
+	const WacomStylus **styli;
+	const int *ids;
+	int nids, nstyli;
+
+	g_assert_true(libwacom_database_freeze(f->db));
+	g_assert_true(libwacom_database_freeze(f->db));
+
+	/* Anything that still writes to the database crashes from here on */
+	device = libwacom_new_from_usbid(f->db, 0x56a, 0x4200, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_match_get_match_string(libwacom_get_paired_device(device)),
+			==,
+			"usb|2575|0204");
+	libwacom_destroy(device);
+
+	device = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 WL");
+	g_assert_cmpstr(libwacom_match_get_match_string(libwacom_get_matches(device)[0]),
+			==,
+			"usb|056a|00bc");
+
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	ids = libwacom_get_supported_styli(device, &nids);
+	G_GNUC_END_IGNORE_DEPRECATIONS
+	g_assert_nonnull(ids);
+	g_assert_cmpint(nids, >, 0);
+
+	styli = libwacom_get_styli(device, &nstyli);
+	g_assert_cmpint(nstyli, >, 0);
+	for (int i = 0; i < nstyli; i++) {
+		G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+		libwacom_stylus_get_paired_ids(styli[i], NULL);
+		G_GNUC_END_IGNORE_DEPRECATIONS
+	}
+	g_free(styli);
+
+	libwacom_builder_set_usbid(builder, 0x1234, 0x5678);
+	libwacom_builder_set_device_name(builder, "Some Unknown Tablet");
+	fallback = libwacom_new_from_builder(f->db, builder, WFALLBACK_GENERIC, NULL);
+	g_assert_nonnull(fallback);
+	g_assert_cmpstr(libwacom_get_name(fallback), ==, "Some Unknown Tablet");
+	libwacom_builder_destroy(builder);
+
+	free(libwacom_database_get_stats(f->db));
+
+	libwacom_destroy(device);
+	libwacom_destroy(fallback);
+}
+
+static void
+test_freeze_read_only(struct fixture *f,
+		      gconstpointer user_data)
+{
+	if (g_test_subprocess()) {
+		WacomDevice *device;
+		WacomStatusLEDs *leds;
+		int num_leds;
+
+		device = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+		leds = (WacomStatusLEDs *)libwacom_get_status_leds(device, &num_leds);
+		g_assert_cmpint(num_leds, >, 0);
+
+		g_assert_true(libwacom_database_freeze(f->db));
+		leds[0] = WACOM_STATUS_LED_UNAVAILABLE;
+		return;
+	}
+
+	/* The write into the frozen database must fault */
+	g_test_trap_subprocess(NULL, 0, 0);
+	g_test_trap_assert_failed();
+}
+
+#if HAVE_MEMFD_CREATE
+static void
+check_same_devices(WacomDeviceDatabase *db,
+		   WacomDeviceDatabase *image)
+{
+	WacomDevice **devices = libwacom_list_devices_from_database(db, NULL);
+	WacomDevice **loaded = libwacom_list_devices_from_database(image, NULL);
+	int i;
+
+	for (i = 0; devices[i] && loaded[i]; i++) {
+		const WacomMatch **a = libwacom_get_matches(devices[i]);
+		const WacomMatch **b = libwacom_get_matches(loaded[i]);
+
+		g_assert_true(libwacom_compare(devices[i],
+					       loaded[i],
+					       WCOMPARE_MATCHES) == 0);
+		g_assert_cmpstr(libwacom_get_name(devices[i]),
+				==,
+				libwacom_get_name(loaded[i]));
+		for (; *a && *b; a++, b++)
+			g_assert_cmpstr(libwacom_match_get_match_string(*a),
+					==,
+					libwacom_match_get_match_string(*b));
+		g_assert_true(*a == NULL && *b == NULL);
+	}
+	g_assert_true(devices[i] == NULL && loaded[i] == NULL);
+
+	free(devices);
+	free(loaded);
+}
+
+static void
+check_image_database(WacomDeviceDatabase *image)
+{
+	WacomDevice *device;
+	WacomStylusResolver *resolver;
+	const WacomStylus **styli;
+	int nstyli;
+
+	device = libwacom_new_from_usbid(image, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 WL");
+	g_assert_cmpint(libwacom_get_num_buttons(device), ==, 9);
+
+	resolver = libwacom_stylus_resolver_new(image, device);
+	styli = libwacom_get_styli(device, &nstyli);
+	g_assert_cmpint(nstyli, >, 0);
+	for (int i = 0; i < nstyli; i++) {
+		const WacomStylus **paired;
+		int npaired;
+
+		g_assert_nonnull(libwacom_stylus_get_name(styli[i]));
+		g_assert_true(libwacom_stylus_resolver_is_supported(resolver, styli[i]));
+		g_assert_true(libwacom_stylus_get_for_vid_and_id(
+				      image,
+				      libwacom_stylus_get_vendor_id(styli[i]),
+				      libwacom_stylus_get_id(styli[i])) == styli[i]);
+		paired = libwacom_stylus_get_paired_styli(styli[i], &npaired);
+		for (int j = 0; j < npaired; j++)
+			g_assert_nonnull(libwacom_stylus_get_name(paired[j]));
+		g_free(paired);
+	}
+	g_free(styli);
+	libwacom_stylus_resolver_destroy(resolver);
+	libwacom_destroy(device);
+
+	device = libwacom_new_from_name(image, "Wacom Cintiq 13HD", NULL);
+	g_assert_nonnull(device);
+	libwacom_destroy(device);
+}
+
+/* Every mapping of the image shares its pages, none is a private copy */
+static void
+check_image_mappings(int expected)
+{
+	g_autofree char *maps = NULL;
+	g_auto(GStrv) lines = NULL;
+	int count = 0;
+
+	g_assert_true(g_file_get_contents("/proc/self/maps", &maps, NULL, NULL));
+	lines = g_strsplit(maps, "\n", -1);
+	for (char **line = lines; *line; line++) {
+		if (!strstr(*line, "memfd:libwacom-database"))
+			continue;
+		g_assert_nonnull(strstr(*line, " r--s "));
+		count++;
+	}
+	g_assert_cmpint(count, ==, expected);
+}
+
+static void
+test_image(struct fixture *f,
+	   gconstpointer user_data)
+{
+	WacomDeviceDatabase *image, *second;
+	WacomDevice *device;
+	int fd;
+
+	fd = libwacom_database_export_fd(f->db, NULL);
+	g_assert_cmpint(fd, >=, 0);
+
+	image = libwacom_database_new_from_fd(fd, NULL);
+	g_assert_nonnull(image);
+	second = libwacom_database_new_from_fd(fd, NULL);
+	g_assert_nonnull(second);
+	close(fd);
+	check_image_mappings(2);
+
+	check_same_devices(f->db, image);
+	check_same_devices(f->db, second);
+
+	/* Images outlive the database they were created from, and the
+	 * devices outlive the image */
+	libwacom_database_destroy(f->db);
+	f->db = NULL;
+	device = libwacom_new_from_usbid(image, 0x56a, 0x00bc, NULL);
+	check_image_database(image);
+	check_image_database(second);
+	libwacom_database_destroy(image);
+	libwacom_database_destroy(second);
+	check_image_mappings(1);
+
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 WL");
+	libwacom_destroy(device);
+	check_image_mappings(0);
+}
+
+static void
+test_image_invalid(struct fixture *f,
+		   gconstpointer user_data)
+{
+	WacomError *error = libwacom_error_new();
+	char garbage[4096];
+	int fd;
+
+	/* Not sealed */
+	fd = memfd_create("test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	g_assert_cmpint(fd, >=, 0);
+	g_assert_null(libwacom_database_new_from_fd(fd, error));
+	g_assert_cmpint(libwacom_error_get_code(error), ==, WERROR_INVALID_DB);
+	close(fd);
+
+	/* Sealed, but not an image */
+	memset(garbage, 0xab, sizeof(garbage));
+	fd = memfd_create("test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	g_assert_cmpint(write(fd, garbage, sizeof(garbage)), ==, sizeof(garbage));
+	g_assert_cmpint(fcntl(fd,
+			      F_ADD_SEALS,
+			      F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE),
+			==,
+			0);
+	g_assert_null(libwacom_database_new_from_fd(fd, error));
+	g_assert_cmpint(libwacom_error_get_code(error), ==, WERROR_INVALID_DB);
+	close(fd);
+
+	libwacom_error_free(&error);
+}
+#endif
+
 int
 main(int argc,
      char **argv)
@@ -390,6 +1221,86 @@ main(int argc,
 		   fixture_setup,
 		   test_isdv4_4800,
 		   fixture_teardown);
+	g_test_add("/load/outlives-database",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_outlives_database,
+		   fixture_teardown);
+	g_test_add("/load/deprecated-ids",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_deprecated_ids,
+		   fixture_teardown);
+	g_test_add("/load/stats",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_stats,
+		   fixture_teardown);
+	g_test_add("/load/stylus-resolver",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_stylus_resolver,
+		   fixture_teardown);
+	g_test_add("/load/stylus-devices",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_stylus_devices,
+		   fixture_teardown);
+	g_test_add("/load/stylus-for-vid-and-id",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_stylus_for_vid_and_id,
+		   fixture_teardown);
+	g_test_add("/load/export-styli",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_export_styli,
+		   fixture_teardown);
+	g_test_add("/load/device-descriptor",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_device_descriptor,
+		   fixture_teardown);
+	g_test_add("/load/pad-mode-tracker",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_pad_mode_tracker,
+		   fixture_teardown);
+	g_test_add("/load/freeze",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_freeze,
+		   fixture_teardown);
+	g_test_add("/load/freeze/read-only",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_freeze_read_only,
+		   fixture_teardown);
+#if HAVE_MEMFD_CREATE
+	g_test_add("/load/image",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_image,
+		   fixture_teardown);
+	g_test_add("/load/image-invalid",
+		   struct fixture,
+		   NULL,
+		   fixture_setup,
+		   test_image_invalid,
+		   fixture_teardown);
+#endif
 
 	return g_test_run();
 }
@@ -250,10 +250,33 @@ static void
 test_buttons(gconstpointer data)
 {
 	WacomDevice *device = (WacomDevice *)data;
+	const int *led_groups;
+	int num_buttons;
 
 	g_assert_cmpint(libwacom_get_num_buttons(device), >=, 0);
 	g_assert_true(buttons_have_direction(device));
 
+	led_groups = libwacom_get_button_led_groups(device, &num_buttons);
+	g_assert_cmpint(num_buttons, ==, libwacom_get_num_buttons(device));
+
+	for (char b = 'A'; b < 'A' + libwacom_get_num_buttons(device); b++) {
+		int code = libwacom_get_button_evdev_code(device, b);
+		char other;
+
+		g_assert_cmpint(led_groups[b - 'A'],
+				==,
+				libwacom_get_button_led_group(device, b));
+
+		if (code == 0)
+			continue;
+
+		/* The first button with this code */
+		other = libwacom_get_button_for_evdev_code(device, code);
+		g_assert_cmpint(other, >=, 'A');
+		g_assert_cmpint(other, <=, b);
+		g_assert_cmpint(libwacom_get_button_evdev_code(device, other), ==, code);
+	}
+
 	if (libwacom_is_reversible(device) && libwacom_get_num_buttons(device) > 0)
 		g_assert_true(tablet_has_lr_buttons(device));
 }
@@ -288,6 +311,46 @@ test_styli(gconstpointer data)
 	}
 }
 
+static void
+test_stylus_summary(gconstpointer data)
+{
+	WacomDevice *device = (WacomDevice *)data;
+	const WacomStylusSummary *summary = libwacom_get_stylus_summary(device);
+	g_autofree const WacomStylus **styli = NULL;
+	WacomAxisTypeFlags axes_any = WACOM_AXIS_TYPE_NONE;
+	WacomAxisTypeFlags axes_all = ~0;
+	uint32_t types = 0, eraser_types = 0;
+	int max_buttons = 0, nstyli;
+	gboolean has_eraser = FALSE, has_lens = FALSE, has_wheel = FALSE;
+
+	styli = libwacom_get_styli(device, &nstyli);
+	if (nstyli == 0)
+		axes_all = WACOM_AXIS_TYPE_NONE;
+
+	for (int i = 0; i < nstyli; i++) {
+		const WacomStylus *stylus = styli[i];
+
+		axes_any |= libwacom_stylus_get_axes(stylus);
+		axes_all &= libwacom_stylus_get_axes(stylus);
+		max_buttons = MAX(max_buttons, libwacom_stylus_get_num_buttons(stylus));
+		has_eraser |= !!libwacom_stylus_has_eraser(stylus);
+		has_lens |= !!libwacom_stylus_has_lens(stylus);
+		has_wheel |= !!libwacom_stylus_has_wheel(stylus);
+		eraser_types |= 1U << libwacom_stylus_get_eraser_type(stylus);
+		types |= 1U << libwacom_stylus_get_type(stylus);
+	}
+
+	g_assert_cmpint(summary->num_styli, ==, nstyli);
+	g_assert_cmpint(summary->axes_any, ==, axes_any);
+	g_assert_cmpint(summary->axes_all, ==, axes_all);
+	g_assert_cmpint(summary->max_buttons, ==, max_buttons);
+	g_assert_cmpint(!!summary->has_eraser, ==, has_eraser);
+	g_assert_cmpint(!!summary->has_lens, ==, has_lens);
+	g_assert_cmpint(!!summary->has_wheel, ==, has_wheel);
+	g_assert_cmpint(summary->eraser_types, ==, eraser_types);
+	g_assert_cmpint(summary->types, ==, types);
+}
+
 static void
 test_no_styli(gconstpointer data)
 {
@@ -390,6 +453,35 @@ test_dials(gconstpointer data)
 						WACOM_BUTTON_DIAL2_MODESWITCH));
 }
 
+static void
+test_mode_tracker(gconstpointer data)
+{
+	WacomDevice *device = (WacomDevice *)data;
+	WacomPadModeTracker *tracker = libwacom_pad_mode_tracker_new(device);
+
+	for (char b = 'A'; b < 'A' + libwacom_get_num_buttons(device); b++) {
+		WacomButtonFlags flags = libwacom_get_button_flag(device, b);
+		int mode = -1;
+		int group = libwacom_pad_mode_tracker_button_pressed(tracker, b, &mode);
+
+		if (!(flags & WACOM_BUTTON_MODESWITCH)) {
+			g_assert_cmpint(group, ==, -1);
+			continue;
+		}
+
+		g_assert_cmpint(group, >=, 0);
+		g_assert_cmpint(mode, >=, 0);
+		g_assert_cmpint(mode,
+				<,
+				libwacom_pad_mode_tracker_get_num_modes(tracker, group));
+		g_assert_cmpint(libwacom_pad_mode_tracker_get_led_group(tracker, group),
+				==,
+				libwacom_get_button_led_group(device, b));
+	}
+
+	libwacom_pad_mode_tracker_destroy(tracker);
+}
+
 /* Wrapper function to make adding tests simpler. g_test requires
  * a unique test case name so we assemble that from the test function and
  * the tablet data.
@@ -439,6 +531,7 @@ setup_tests(WacomDevice *device)
 	add_test(device, test_rings);
 	add_test(device, test_strips);
 	add_test(device, test_dials);
+	add_test(device, test_mode_tracker);
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
@@ -446,6 +539,7 @@ setup_tests(WacomDevice *device)
 #pragma GCC diagnostic pop
 
 	add_test(device, test_dimensions);
+	add_test(device, test_stylus_summary);
 
 	/* FIXME: we force the generic pen for these, should add a test */
 	if (libwacom_has_stylus(device))
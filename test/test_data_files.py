@@ -26,6 +26,9 @@ def pytest_generate_tests(metafunc):
     if "tabletfile" in metafunc.fixturenames:
         files = [f for f in datadir().glob("*.tablet")]
         metafunc.parametrize("tabletfile", files, ids=[f.name for f in files])
+    if "uniqfile" in metafunc.fixturenames:
+        files = [f for f in datadir().glob("*.uniq")]
+        metafunc.parametrize("uniqfile", files, ids=[f.name for f in files])
 
 
 def test_device_match(tabletfile):
@@ -102,3 +105,20 @@ def test_button_evcodes(tabletfile):
         assert len(codes) == nbuttons, "Number of buttons mismatches the EvdevCodes"
     except KeyError:
         pass
+
+
+def test_uniq_rules(uniqfile):
+    config = configparser.ConfigParser(strict=True)
+    # Don't convert to lowercase
+    config.optionxform = lambda option: option
+    config.read(uniqfile)
+
+    for name in config.sections():
+        rule = config[name]
+        unknown = set(rule.keys()) - {"Prefix", "Separator", "MinFields", "StripFields"}
+        assert not unknown, f"{uniqfile}: [{name}] has unknown keys {unknown}"
+        assert len(rule["Separator"]) == 1, (
+            f"{uniqfile}: [{name}] Separator must be a single character"
+        )
+        assert int(rule["StripFields"]) >= 1
+        assert int(rule.get("MinFields", "0")) >= 0
@@ -1,7 +1,9 @@
 # This file is formatted with ruff format
 
 import ctypes
+import functools
 import logging
+import operator
 import string
 from configparser import ConfigParser
 from dataclasses import dataclass, field
@@ -9,6 +11,7 @@ from dataclasses import dataclass, field
 import pytest
 
 from . import (
+    LibWacom,
     WacomAxisType,
     WacomBuilder,
     WacomBustype,
@@ -266,6 +269,9 @@ def test_cintiq13hd(db):
     assert device.button_evdev_code("G") == libevdev.EV_KEY.BTN_6.value
     assert device.button_evdev_code("H") == libevdev.EV_KEY.BTN_7.value
     assert device.button_evdev_code("I") == libevdev.EV_KEY.BTN_8.value
+    assert device.button_for_evdev_code(libevdev.EV_KEY.BTN_0.value) == "A"
+    assert device.button_for_evdev_code(libevdev.EV_KEY.BTN_8.value) == "I"
+    assert device.button_for_evdev_code(libevdev.EV_KEY.BTN_9.value) is None
     assert device.model_name == "DTK-1300"
 
 
@@ -278,6 +284,113 @@ def test_cintiqpro13(db):
         assert device.button_modeswitch_mode(btn) == WacomDevice.ModeSwitch.NEXT
 
 
+def test_cintiqpro13_keys(db):
+    libevdev = pytest.importorskip("libevdev")
+
+    device = db.new_from_name("Wacom Cintiq Pro 13")
+    assert device is not None
+    assert (
+        device.key_for_code(
+            libevdev.EV_KEY.value, libevdev.EV_KEY.KEY_ONSCREEN_KEYBOARD.value
+        )
+        == 2
+    )
+    assert (
+        device.key_for_code(libevdev.EV_SW.value, libevdev.EV_SW.SW_MUTE_DEVICE.value)
+        == 4
+    )
+    assert device.key_for_code(libevdev.EV_KEY.value, 0) is None
+
+
+def test_stylus_summary(db):
+    # test-tablet-validity checks the summary of every device, this
+    # checks the ctypes struct against one
+    device = db.new_from_usbid(0x56A, 0x0357)
+    styli = device.get_styli()
+    summary = device.stylus_summary
+    assert ctypes.sizeof(summary) == 36
+    assert summary.num_styli == len(styli)
+    assert summary.max_buttons == max(s.num_buttons for s in styli)
+    assert summary.has_eraser
+    assert summary.types == functools.reduce(
+        operator.or_, (1 << s.stylus_type for s in styli)
+    )
+    assert summary.eraser_types == functools.reduce(
+        operator.or_, (1 << s.eraser_type for s in styli)
+    )
+
+
+def test_device_descriptor(db):
+    for device in db.list_devices():
+        d = device.descriptor
+
+        assert d.version == d.VERSION
+        assert d.size == ctypes.sizeof(d)
+        assert d.flags == 0
+        assert d.match.vendor_id == device.vendor_id
+        assert d.match.product_id == device.product_id
+        assert d.match.bustype == device.bustype
+        paired = device.paired_device
+        if paired is not None:
+            assert (d.paired.vendor_id, d.paired.product_id) == (
+                paired.vendor_id,
+                paired.product_id,
+            )
+        else:
+            assert d.paired.bustype == WacomBustype.UNKNOWN
+        assert d.width_mm == device.width_mm
+        assert d.height_mm == device.height_mm
+        assert d.num_rings == device.num_rings
+        assert d.num_strips == device.num_strips
+        assert d.ring_num_modes == device.ring_num_modes
+        assert d.num_buttons == device.num_buttons
+        assert d.num_keys == device.num_keys
+        assert list(d.status_leds[: d.num_status_leds]) == device.status_leds
+
+        for i, b in enumerate(string.ascii_uppercase):
+            button = d.buttons[i]
+            assert button.flags == device.get_button_flag(b.encode("utf-8"))
+            assert button.code == device.button_evdev_code(b)
+            assert button.mode == device.button_modeswitch_mode(b)
+            assert button.led_group == device.button_led_group(b)
+
+        styli = device.get_styli()
+        assert [(s.vendor_id, s.tool_id) for s in d.styli[: d.num_styli]] == [
+            (s.vendor_id, s.tool_id) for s in styli
+        ]
+        assert [
+            (m.vendor_id, m.product_id) for m in d.matches[: d.num_matches]
+        ] == [(m.vendor_id, m.product_id) for m in device.matches]
+
+
+def test_export_styli(db):
+    # test-load checks the records of every stylus and device, this
+    # checks the ctypes structs and the wrapper against one pair
+    records, paired, strings = db.export_styli()
+    assert ctypes.sizeof(records[0]) == 40
+    assert len(records) == len(db.list_styli())
+
+    ids = [(r.vendor_id, r.tool_id) for r in records]
+    pen = records[ids.index((0, 0xFFFFF))]
+    name = strings[pen.name : strings.index(b"\0", pen.name)]
+    assert name == b"General Pen"
+    assert pen.num_buttons == 2
+    assert pen.type == WacomStylusType.GENERAL
+    assert pen.flags & pen.HAS_ERASER
+    assert pen.flags & pen.IS_GENERIC
+    assert pen.axes == (
+        WacomAxisType.TILT | WacomAxisType.PRESSURE | WacomAxisType.DISTANCE
+    )
+    assert pen.num_paired == 1
+    assert ids[paired[pen.paired_first]] == (0, 0xFFFFE)
+
+    device = db.new_from_usbid(0x56A, 0x0357)
+    records, paired, strings = db.export_styli(device)
+    assert [(r.vendor_id, r.tool_id) for r in records] == [
+        (s.vendor_id, s.tool_id) for s in device.get_styli()
+    ]
+
+
 def test_dell_canvas(db):
     device = db.new_from_name("Dell Canvas 27")
     assert device is not None
@@ -598,6 +711,35 @@ def test_new_from_path_known_device(db, fallback):
     assert dev.product_id == pid
 
 
+def test_print_udev_info(tmp_path):
+    name = "Wacom Intuos4 WL"
+    vid = 0x056A
+    pid = 0x00BC
+    uinput = create_uinput(name, vid, pid)
+
+    lib = LibWacom.instance()
+    path = tmp_path / "udev-info"
+    with open(path, "w") as f:
+        rc = lib.print_udev_info(f.fileno(), uinput.devnode.encode("utf-8"), 0)
+    assert rc == 0
+
+    info = path.read_text().splitlines()
+    assert info[0] == "[UdevInfo]"
+    assert f"DevNode={uinput.devnode}" in info
+    assert f"Name={name}" in info
+    assert any(line.startswith(f"Product=3/{vid:x}/{pid:x}/") for line in info)
+    assert "TabletOrTouchpad=true" in info
+
+
+def test_print_udev_info_invalid_path(tmp_path):
+    lib = LibWacom.instance()
+    path = tmp_path / "udev-info"
+    with open(path, "w") as f:
+        rc = lib.print_udev_info(f.fileno(), b"/dev/input/does-not-exist", 0)
+    assert rc < 0
+    assert path.read_text() == ""
+
+
 @pytest.mark.parametrize("bustype", WacomBustype)
 @pytest.mark.parametrize(
     "fallback", (WacomDatabase.Fallback.NONE, WacomDatabase.Fallback.GENERIC)
@@ -756,6 +898,11 @@ def test_status_leds(custom_datadir, feature, count):
         led_group = device.button_led_group(b)
         assert led_group == -1
 
+    assert device.button_led_groups == [
+        device.button_led_group(b)
+        for b in string.ascii_uppercase[: device.num_buttons]
+    ]
+
 
 def test_nonwacom_stylus_ids(tmp_path):
     styli = StylusFile.default()
@@ -829,6 +976,83 @@ def test_nonwacom_stylus_ids(tmp_path):
     assert sum(s.vendor_id == 0 and s.tool_id == 0xAFFFE for s in styli) == 1
     assert sum(s.vendor_id == 0 and s.tool_id == 0xAFFFF for s in styli) == 1
 
+    stylus = db.stylus_for_vid_and_id(0x1234, 0xABCD)
+    assert stylus is not None
+    assert stylus.name == "ABC Pen"
+    assert db.stylus_for_vid_and_id(0x1234, 0x9876).name == "9876 Pen"
+    assert db.stylus_for_vid_and_id(0x56A, 0xABCD) is None
+    assert db.stylus_for_vid_and_id(0x1234, 0x1) is None
+
+
+def test_paired_pen_and_eraser(tmp_path, capfd):
+    styli = StylusFile.default()
+    # Only the pen lists the eraser, the pairing applies both ways
+    styli.entries.append(
+        StylusEntry(
+            id="0x1234:0x1",
+            name="One-sided Pen",
+            group="one-sided",
+            paired_stylus_ids=["0x1234:0x2"],
+        )
+    )
+    styli.entries.append(
+        StylusEntry(
+            id="0x1234:0x2",
+            name="One-sided Eraser",
+            group="one-sided",
+            eraser_type="Invert",
+        )
+    )
+    styli.entries.append(
+        StylusEntry(id="0x1234:0x3", name="Lonely Pen", group="one-sided")
+    )
+    # Listed before the first pen in the file, but the eraser still
+    # pairs with the lowest id
+    styli.entries.insert(
+        0,
+        StylusEntry(
+            id="0x1234:0x4",
+            name="Another One-sided Pen",
+            group="one-sided",
+            paired_stylus_ids=["0x1234:0x2"],
+        ),
+    )
+    styli.write_to_dir(tmp_path)
+    TabletFile(
+        name="Pairing Tablet",
+        matches=["usb|1234|abcd"],
+        styli=["@one-sided", "@generic-with-eraser"],
+    ).write_to(tmp_path / "pairing.tablet")
+
+    db = WacomDatabase(path=tmp_path)
+    stderr = capfd.readouterr().err
+    assert "Stylus 1234:1 is paired with 1234:2 but not vice versa" in stderr
+    assert "Stylus 1234:4 is paired with 1234:2 but not vice versa" in stderr
+
+    builder = WacomBuilder.create(usbid=(0x1234, 0xABCD))
+    device = db.new_from_builder(builder)
+    assert device is not None
+
+    styli = {(s.vendor_id, s.tool_id): s for s in device.get_styli()}
+    assert len(styli) == 6
+
+    pen, eraser = styli[(0, 0xAFFFF)], styli[(0, 0xAFFFE)]
+    assert pen.paired_eraser.tool_id == eraser.tool_id
+    assert pen.paired_pen is None
+    assert eraser.paired_pen.tool_id == pen.tool_id
+    assert eraser.paired_eraser is None
+
+    pen, eraser = styli[(0x1234, 0x1)], styli[(0x1234, 0x2)]
+    assert pen.paired_eraser.tool_id == eraser.tool_id
+    assert eraser.paired_pen.tool_id == pen.tool_id
+
+    other_pen = styli[(0x1234, 0x4)]
+    assert other_pen.paired_eraser.tool_id == eraser.tool_id
+
+    lonely = styli[(0x1234, 0x3)]
+    assert lonely.paired_eraser is None
+    assert lonely.paired_pen is None
+
 
 def test_list_styli_from_database(tmp_path):
     styli = StylusFile.default()
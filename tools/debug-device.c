@@ -157,6 +157,8 @@ handle_device(WacomDeviceDatabase *db,
 	if (parts && parts[0] && parts[1]) {
 		device = device_from_device_match(db, parts);
 	} else {
+		if (libwacom_print_udev_info(STDOUT_FILENO, path, NULL) == 0)
+			printf("\n");
 		device = libwacom_new_from_path(db, path, WFALLBACK_NONE, NULL);
 	}
 
@@ -68,32 +68,76 @@ print_device_info(const WacomDeviceDatabase *db,
 	}
 }
 
+static void
+print_stylus_info(const WacomStylus *stylus)
+{
+	WacomDevice *const *devices;
+	int ndevices;
+
+	printf("- name: '%s'\n", libwacom_stylus_get_name(stylus));
+	printf("  id: '0x%x:0x%x'\n",
+	       libwacom_stylus_get_vendor_id(stylus),
+	       libwacom_stylus_get_id(stylus));
+
+	devices = libwacom_stylus_list_devices(stylus, &ndevices);
+	if (ndevices == 0) {
+		printf("  devices: []\n");
+		return;
+	}
+
+	printf("  devices:\n");
+	for (int i = 0; i < ndevices; i++)
+		printf("    - '%s'\n", libwacom_get_name(devices[i]));
+}
+
 int
 main(int argc,
      char **argv)
 {
 	WacomDeviceDatabase *db;
-	WacomDevice **list, **p;
+	gboolean by_stylus = FALSE;
 
 	if (argc > 1) {
-		printf("Usage: %s [--help] - list compatible styli\n",
-		       basename(argv[0]));
-		return g_str_equal(argv[1], "--help");
+		if (argc == 2 && g_str_equal(argv[1], "--by-stylus")) {
+			by_stylus = TRUE;
+		} else {
+			printf("Usage: %s [--help] [--by-stylus] - list compatible styli\n",
+			       basename(argv[0]));
+			return g_str_equal(argv[1], "--help");
+		}
 	}
 
 	db = libwacom_database_new_for_path(DATABASEPATH);
 
-	list = libwacom_list_devices_from_database(db, NULL);
-	if (!list) {
-		fprintf(stderr, "Failed to load device database.\n");
-		return 1;
-	}
+	if (by_stylus) {
+		const WacomStylus **styli, **s;
+
+		styli = libwacom_list_styli_from_database(db, NULL);
+		if (!styli) {
+			fprintf(stderr, "Failed to load device database.\n");
+			return 1;
+		}
+
+		for (s = styli; *s; s++)
+			print_stylus_info(*s);
 
-	for (p = list; *p; p++)
-		print_device_info(db, (WacomDevice *)*p);
+		g_free(styli);
+	} else {
+		WacomDevice **list, **p;
+
+		list = libwacom_list_devices_from_database(db, NULL);
+		if (!list) {
+			fprintf(stderr, "Failed to load device database.\n");
+			return 1;
+		}
+
+		for (p = list; *p; p++)
+			print_device_info(db, (WacomDevice *)*p);
+
+		g_free(list);
+	}
 
 	libwacom_database_destroy(db);
-	g_free(list);
 
 	return 0;
 }
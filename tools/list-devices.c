@@ -42,6 +42,8 @@ static enum output_format {
 	DATAFILE,
 } output_format = YAML;
 
+static gboolean show_stats = FALSE;
+
 static void
 print_device_info(WacomDevice *device,
 		  WacomBusType bus_type_filter,
@@ -99,6 +101,36 @@ print_device_info(WacomDevice *device,
 	}
 }
 
+static void
+print_stats(WacomDeviceDatabase *db)
+{
+	g_autofree WacomDatabaseStats *stats = libwacom_database_get_stats(db);
+
+	printf("stats:\n");
+	printf("  devices:     { count: %zu, bytes: %zu }\n",
+	       stats->num_devices,
+	       stats->devices_bytes);
+	printf("  matches:     { count: %zu, bytes: %zu }\n",
+	       stats->num_matches,
+	       stats->matches_bytes);
+	printf("  styli:       { count: %zu, bytes: %zu }\n",
+	       stats->num_styli,
+	       stats->styli_bytes);
+	printf("  buttons:     { count: %zu, bytes: %zu }\n",
+	       stats->num_buttons,
+	       stats->buttons_bytes);
+	printf("  strings:     { count: %zu, bytes: %zu }\n",
+	       stats->num_strings,
+	       stats->strings_bytes);
+	printf("  hash-tables: { count: %zu, bytes: %zu }\n",
+	       stats->num_hash_tables,
+	       stats->hash_table_bytes);
+	printf("  handles:     { count: %zu, bytes: %zu }\n",
+	       stats->num_handles,
+	       stats->handles_bytes);
+	printf("  arena:       { bytes: %zu }\n", stats->arena_bytes);
+}
+
 static gboolean
 check_format(const gchar *option_name,
 	     const gchar *value,
@@ -117,6 +149,7 @@ check_format(const gchar *option_name,
 /* clang-format off */
 static GOptionEntry opts[] = {
 	{ "format", 0, 0, G_OPTION_ARG_CALLBACK, check_format, N_("Output format, one of 'yaml', 'datafile'"), NULL },
+	{ "stats", 0, 0, G_OPTION_ARG_NONE, &show_stats, N_("Print the memory used by the database instead"), NULL },
 	{ .long_name = NULL }
 };
 /* clang-format on */
@@ -144,6 +177,17 @@ main(int argc,
 	db = libwacom_database_new();
 #endif
 
+	if (!db) {
+		fprintf(stderr, "Failed to load device database.\n");
+		return 1;
+	}
+
+	if (show_stats) {
+		print_stats(db);
+		libwacom_database_destroy(db);
+		return 0;
+	}
+
 	list = libwacom_list_devices_from_database(db, NULL);
 	if (!list) {
 		fprintf(stderr, "Failed to load device database.\n");